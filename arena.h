@@ -0,0 +1,57 @@
+#ifndef __HW1__ARENA__
+#define __HW1__ARENA__
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* Monotonic allocator: objects are carved out of large blocks one after another and
+   never freed one by one. Destroying the arena releases every block at once, so it
+   only holds trivially destructible types. Movable, not copyable. */
+class Arena{
+    public:
+        explicit Arena(size_t block_size = 64 * 1024): block_size(block_size), used(0), capacity(0), reserved(0) {}
+
+        void* allocate(size_t size, size_t alignment){
+            size_t offset = (used + alignment - 1) & ~(alignment - 1);
+            if (blocks.empty() || offset + size > capacity){
+                /* Oversized requests get a block of their own; alignment is at most the default new's */
+                size_t new_capacity = std::max(block_size, size);
+                blocks.emplace_back(new char[new_capacity]);
+                capacity = new_capacity;
+                reserved += new_capacity;
+                offset = 0;
+            }
+            used = offset + size;
+            return blocks.back().get() + offset;
+        }
+
+        template<typename T, typename... Args>
+        T* create(Args&&... args){
+            static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed");
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        /* Uninitialized room for count objects of type T */
+        template<typename T>
+        T* allocateArray(size_t count){
+            static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed");
+            return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        }
+
+        /* Bytes of every block taken from the heap so far */
+        size_t bytesReserved() const { return reserved; }
+
+    private:
+        size_t block_size;
+        size_t used;                            // bytes taken from the last block
+        size_t capacity;                        // size of the last block
+        size_t reserved;
+        std::vector<std::unique_ptr<char[]>> blocks;
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "parser.h"
 #include "ray.h"
+#include "vecmath.h"
 
 using parser::Vec3f;
 using std::min;
@@ -10,10 +11,24 @@ using std::max;
 
 class BBox{
     public:
-        Vec3f min_point;
-        Vec3f max_point;
+        Vec4f min_point;
+        Vec4f max_point;
 
-        bool rayIntersect(Ray ray);
+        static BBox merge(const BBox& a, const BBox& b){
+            BBox merged;
+            merged.min_point = Vec4f::min(a.min_point, b.min_point);
+            merged.max_point = Vec4f::max(a.max_point, b.max_point);
+            return merged;
+        }
+
+        /* Half the surface area, proportional to the chance a ray hits the box; 0 when empty */
+        float halfArea() const {
+            Vec4f extent = max_point - min_point;
+            if (extent.minComponent() < 0){
+                return 0.0f;
+            }
+            return extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x();
+        }
 };
 
 #endif
\ No newline at end of file
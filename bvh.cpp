@@ -2,44 +2,360 @@
 #include <algorithm>
 #include <limits>
 #include <vector>
+#include <chrono>
+#include "morton.h"
+#include "lbvh.h"
+#include "sbvh.h"
+#include "treelet.h"
+#include "layout.h"
+#include "wide.h"
+#include "instance.h"
+#include <stdexcept>
 
+static Vec4f centroidOf(const Triangle* triangle){
+    return triangle->centeroid;
+}
+
+static Vec4f centroidOf(const Sphere* sphere){
+    return sphere->center;
+}
+
+/* Sorts primitives by the Morton code of their centroids, so that the median splits start
+   from, and leaves end up with, primitives that are already close in memory and in space */
+template<typename T>
+static void mortonPresort(T** primitives, size_t count){
+    if (count < 2){
+        return;
+    }
+    Vec4f min_point = centroidOf(primitives[0]);
+    Vec4f max_point = min_point;
+    for (size_t i = 1; i < count; i++){
+        min_point = Vec4f::min(min_point, centroidOf(primitives[i]));
+        max_point = Vec4f::max(max_point, centroidOf(primitives[i]));
+    }
+    vector<std::pair<uint64_t, T*>> keyed(count);
+    for (size_t i = 0; i < count; i++){
+        keyed[i] = std::make_pair(morton63(centroidOf(primitives[i]), min_point, max_point), primitives[i]);
+    }
+    std::sort(keyed.begin(), keyed.end(), [](const std::pair<uint64_t, T*>& a, const std::pair<uint64_t, T*>& b) {
+        return a.first < b.first;
+    });
+    for (size_t i = 0; i < count; i++){
+        primitives[i] = keyed[i].second;
+    }
+}
 
 
-BVH_Tree::BVH_Tree(Scene& scene){
+
+/* Builds a tree over the pointer arrays with the chosen builder. The spatial builder replaces
+   the lists with its arrays of references. */
+static Node* buildNodes(PrimitiveList<Triangle>& triangles, PrimitiveList<Sphere>& spheres, const BVHSettings& settings, Arena& arena){
+    if (settings.builder == BVHBuilder::LINEAR){
+        return buildLinearBVH(triangles, spheres, settings.morton_bits, arena);
+    }
+    if (settings.builder == BVHBuilder::SPATIAL){
+        return buildSpatialBVH(triangles, spheres, settings.duplication_budget, arena);
+    }
+    if (settings.morton_presort){
+        mortonPresort(triangles.first, triangles.size());
+        mortonPresort(spheres.first, spheres.size());
+    }
+    return arena.create<Node>(triangles, spheres, 1, arena);
+}
+
+/* Pointer arrays in arena to the given triangles of scene and to its first sphere_count spheres */
+static void collectPrimitives(Scene& scene, size_t first_triangle, size_t triangle_count, size_t sphere_count, Arena& arena,
+                              PrimitiveList<Triangle>& triangles, PrimitiveList<Sphere>& spheres){
+    triangles.first = arena.allocateArray<Triangle*>(triangle_count);
+    triangles.last = triangles.first + triangle_count;
+    spheres.first = arena.allocateArray<Sphere*>(sphere_count);
+    spheres.last = spheres.first + sphere_count;
+    for (size_t i = 0; i < triangle_count; i++){
+        triangles.first[i] = &scene.triangles[first_triangle + i];
+    }
+    for (size_t i = 0; i < sphere_count; i++){
+        spheres.first[i] = &scene.spheres[i];
+    }
+}
+
+BVH_Tree::BVH_Tree(Scene& scene, const KernelSet& kernel_set, const BVHSettings& settings, bool backface_culling_enabled):
+    settings(settings), backface_culling(backface_culling_enabled) {
     configureHead(scene);
+    selectKernels(scene, kernel_set, backface_culling_enabled);
 }
 
 void BVH_Tree::configureHead(Scene& scene){
-    vector<Triangle*> triangles;
-    vector<Sphere*> spheres;
-    for (Triangle& triangle : scene.triangles) {
-        triangles.push_back(&triangle);
+    auto start = std::chrono::steady_clock::now();
+    triangle_base = scene.triangles.data();
+    sphere_base = scene.spheres.data();
+    /* Instances share their base mesh's tree, which only the two-level build keeps apart */
+    if (!scene.mesh_instances.empty()){
+        settings.two_level = true;
+    }
+    if (settings.two_level){
+        size_t loose_first = 0;
+        bottom_levels.reserve(scene.meshes.size() + 1);
+        for (size_t i = 0; i < scene.meshes.size(); i++){
+            loose_first = max(loose_first, static_cast<size_t>(scene.meshes[i].first_triangle + scene.meshes[i].triangle_count));
+            if (scene.meshes[i].triangle_count > 0){
+                bottom_levels.emplace_back(i);
+                buildBottomLevel(bottom_levels.back(), scene);
+            }
+        }
+        if (loose_first < scene.triangles.size() || !scene.spheres.empty()){
+            bottom_levels.emplace_back(-1);
+            buildBottomLevel(bottom_levels.back(), scene);
+        }
+        linkTopLevel(scene);
+        if (settings.optimize_treelets){
+            build_stats.sah_cost_before_treelets = surfaceAreaCost(head);
+            float budget = settings.treelet_time_budget;
+            for (BottomLevelBVH& bottom : bottom_levels){
+                float remaining = budget - std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+                optimizeBottomLevel(bottom, max(remaining, 0.0f));
+            }
+        }
+    }
+    else{
+        PrimitiveList<Triangle> triangle_list;
+        PrimitiveList<Sphere> sphere_list;
+        collectPrimitives(scene, 0, scene.triangles.size(), scene.spheres.size(), arena, triangle_list, sphere_list);
+        head = buildNodes(triangle_list, sphere_list, settings, arena);
+        if (settings.optimize_treelets){
+            optimizeTreelets(head, triangle_list, sphere_list, settings.treelet_time_budget, build_stats);
+        }
+    }
+    finishTree(start);
+}
+
+/* A mesh's triangles, or the triangles after every mesh's together with all spheres. Arena blocks
+   are sized for the nodes, so that small meshes do not each hold a mostly empty 64 KiB block. */
+void BVH_Tree::buildBottomLevel(BottomLevelBVH& bottom, Scene& scene){
+    size_t first_triangle = 0;
+    size_t triangle_count = 0;
+    size_t sphere_count = 0;
+    if (bottom.mesh >= 0){
+        first_triangle = scene.meshes[bottom.mesh].first_triangle;
+        triangle_count = scene.meshes[bottom.mesh].triangle_count;
+    }
+    else{
+        for (const parser::Mesh& mesh : scene.meshes){
+            first_triangle = max(first_triangle, static_cast<size_t>(mesh.first_triangle + mesh.triangle_count));
+        }
+        triangle_count = scene.triangles.size() - first_triangle;
+        sphere_count = scene.spheres.size();
+    }
+    size_t primitives = triangle_count + sphere_count;
+    bottom.arena = Arena(min<size_t>(64 * 1024, 2 * primitives * (sizeof(Node) + sizeof(void*)) + 64));
+    collectPrimitives(scene, first_triangle, triangle_count, sphere_count, bottom.arena, bottom.triangles, bottom.spheres);
+    bottom.root = buildNodes(bottom.triangles, bottom.spheres, settings, bottom.arena);
+}
+
+/* Treelet restructuring inside one bottom-level tree; its root box, which the top level holds, stays the same */
+void BVH_Tree::optimizeBottomLevel(BottomLevelBVH& bottom, float time_budget){
+    BuildStats stats;
+    optimizeTreelets(bottom.root, bottom.triangles, bottom.spheres, time_budget, stats);
+    build_stats.treelet_passes = max(build_stats.treelet_passes, stats.treelet_passes);
+    build_stats.treelets_restructured += stats.treelets_restructured;
+    build_stats.treelet_milliseconds += stats.treelet_milliseconds;
+}
+
+void BVH_Tree::linkTopLevel(const Scene& scene){
+    auto start = std::chrono::steady_clock::now();
+    vector<Node*> roots;
+    vector<const Node*> mesh_roots(scene.meshes.size(), NULL);
+    for (const BottomLevelBVH& bottom : bottom_levels){
+        roots.push_back(bottom.root);
+        if (bottom.mesh >= 0){
+            mesh_roots[bottom.mesh] = bottom.root;
+        }
+    }
+    build_stats.instances = 0;
+    for (const parser::MeshInstance& mesh_instance : scene.mesh_instances){
+        if (mesh_roots[mesh_instance.base_mesh]){
+            roots.push_back(createInstanceNode(mesh_instance, mesh_roots[mesh_instance.base_mesh], arena));
+            build_stats.instances++;
+        }
+    }
+    head = buildTopLevel(roots, arena);
+    if (head == NULL){
+        head = arena.create<Node>(PrimitiveList<Triangle>(), PrimitiveList<Sphere>(), 1, arena);
+    }
+    build_stats.bottom_levels = bottom_levels.size();
+    build_stats.top_level_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* Passes over the whole tree, which a rebuild of part of it repeats */
+void BVH_Tree::finishTree(std::chrono::steady_clock::time_point start){
+    head = layoutNodes(head, settings.layout, arena);
+    if (settings.wide_nodes){
+        size_t bytes = arena.bytesReserved();
+        wide = buildWideBVH(head, arena);
+        build_stats.wide_nodes = wide.node_count;
+        build_stats.wide_bytes = arena.bytesReserved() - bytes;
+    }
+    build_stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    build_stats.bytes = arena.bytesReserved();
+    for (const BottomLevelBVH& bottom : bottom_levels){
+        build_stats.bytes += bottom.arena.bytesReserved();
+    }
+    build_stats.sah_cost = surfaceAreaCost(head);
+    measure(head, 1);
+}
+
+/* Pointers into the old arrays become pointers to the same positions of the new ones */
+template<typename T>
+static void rebase(PrimitiveList<T> list, const T* old_base, T* new_base){
+    for (T** primitive = list.first; primitive != list.last; primitive++){
+        *primitive = new_base + (*primitive - old_base);
+    }
+}
+
+/* Only the listed meshes' trees are built again, from their current triangles; the other
+   bottom-level trees are linked into a new top level as they are */
+void BVH_Tree::rebuildMeshes(Scene& scene, const vector<int>& meshes){
+    if (!settings.two_level){
+        throw std::runtime_error("Error: Only a two-level BVH can rebuild single meshes.");
     }
-    for (Sphere& sphere: scene.spheres){
-        spheres.push_back(&sphere);
+    auto start = std::chrono::steady_clock::now();
+    build_stats = BuildStats();
+    for (BottomLevelBVH& bottom : bottom_levels){
+        if (std::find(meshes.begin(), meshes.end(), bottom.mesh) != meshes.end()){
+            buildBottomLevel(bottom, scene);
+            if (settings.optimize_treelets){
+                optimizeBottomLevel(bottom, settings.treelet_time_budget);
+            }
+        }
+        else if (scene.triangles.data() != triangle_base || scene.spheres.data() != sphere_base){
+            rebase(bottom.triangles, triangle_base, scene.triangles.data());
+            rebase(bottom.spheres, sphere_base, scene.spheres.data());
+        }
     }
-    head = new Node(triangles, spheres, 1);
+    triangle_base = scene.triangles.data();
+    sphere_base = scene.spheres.data();
+    arena = Arena();
+    wide = WideBVH();
+    linkTopLevel(scene);
+    finishTree(start);
+    selectKernels(scene, *kernels, backface_culling);
 }
 
-ClosestIntersectedObjectInfo BVH_Tree::getIntersectInfo(const Ray& r, bool backface_culling_enabled) const {
+void BVH_Tree::measure(const Node* node, int depth){
+    build_stats.nodes++;
+    build_stats.depth = max(build_stats.depth, depth);
+    if (node->is_leaf){
+        build_stats.leaves++;
+        build_stats.references += node->triangles.size() + node->spheres.size();
+    }
+    if (node->left){
+        measure(node->left, depth + 1);
+    }
+    if (node->right){
+        measure(node->right, depth + 1);
+    }
+}
+
+/* Resolves the instruction set and kernel specialization once so that traversal carries no per-primitive mode checks.
+   Shadow rays never cull back faces, primary and mirror rays do unless disabled. Trees that
+   hold a primitive in several leaves get kernels that test it once per ray. */
+void BVH_Tree::selectKernels(const Scene& scene, const KernelSet& kernel_set, bool backface_culling_enabled){
+    PrimitiveSet primitives = PrimitiveSet::MIXED;
+    if (scene.spheres.empty()){
+        primitives = PrimitiveSet::TRIANGLES_ONLY;
+    }
+    else if (scene.triangles.empty()){
+        primitives = PrimitiveSet::SPHERES_ONLY;
+    }
+
+    ReferenceMode references = build_stats.references > static_cast<long>(scene.triangles.size() + scene.spheres.size())
+        ? ReferenceMode::DUPLICATED : ReferenceMode::UNIQUE;
+
+    kernels = &kernel_set;
+    closest_hit_kernel = kernel_set.closestHit(backface_culling_enabled ? CullingMode::BACKFACE : CullingMode::NONE, primitives, references);
+    any_hit_kernel = kernel_set.anyHit(primitives, references);
+    wide_closest_hit_kernel = kernel_set.wideClosestHit(backface_culling_enabled ? CullingMode::BACKFACE : CullingMode::NONE, primitives, references);
+    wide_any_hit_kernel = kernel_set.wideAnyHit(primitives, references);
+}
+
+ClosestIntersectedObjectInfo BVH_Tree::getIntersectInfo(const Ray& r) const {
     ClosestIntersectedObjectInfo info;
-    head->intersect(r, info, backface_culling_enabled);
+    if (wide.nodes){
+        wide_closest_hit_kernel(wide, r, info);
+    }
+    else{
+        closest_hit_kernel(head, r, info);
+    }
     return info;
 }
 
-/* Prevents memory leak but decreases speed */
-// void BVH_Tree::deleteTree(Node* node) {
-//     if (node == nullptr) return;
+bool BVH_Tree::isOccluded(const Ray& r, float t_max) const {
+    return (wide.nodes ? wide_any_hit_kernel(wide, r, t_max) : any_hit_kernel(head, r, t_max)) != NULL;
+}
+
+/* Neighbouring shadow rays towards the same light are usually blocked by the same
+   primitive, so the leaf that blocked the previous one is tested before the full traversal.
+   An unblocked ray clears the entry, so lit regions do not pay for the extra test. */
+bool BVH_Tree::isOccluded(const Ray& r, float t_max, const Node*& last_occluder, RenderStats& stats) const {
+    if (last_occluder){
+        stats.occluder_cache_lookups++;
+        if (any_hit_kernel(last_occluder, r, t_max)){
+            stats.occluder_cache_hits++;
+            return true;
+        }
+    }
+    last_occluder = wide.nodes ? wide_any_hit_kernel(wide, r, t_max) : any_hit_kernel(head, r, t_max);
+    return last_occluder != NULL;
+}
 
-//     deleteTree(node->left);
-//     deleteTree(node->right);
+long BVH_Tree::countMismatches(const BVH_Tree& reference, int ray_count) const {
+    BBox box = head->bbox;
+    Vec4f extent = box.max_point - box.min_point;
+    uint32_t state = 1;
+    auto next = [&state]() {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) * (1.0f / 16777216.0f);
+    };
+    long mismatches = 0;
+    for (int i = 0; i < ray_count; i++){
+        Vec4f start = box.min_point + extent * Vec4f(next(), next(), next());
+        Vec4f direction(next() - 0.5f, next() - 0.5f, next() - 0.5f);
+        Ray ray(start, direction);
+        ClosestIntersectedObjectInfo hit = getIntersectInfo(ray);
+        ClosestIntersectedObjectInfo expected = reference.getIntersectInfo(ray);
+        if (hit.isIntersectedWithAnyObject != expected.isIntersectedWithAnyObject
+            || (hit.isIntersectedWithAnyObject && (hit.t != expected.t || hit.material_id != expected.material_id))){
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
 
-//     delete node;
-// }
+static float squaredDistanceToBox(const BBox& box, const Vec4f& point){
+    Vec4f outside = Vec4f::max(Vec4f::max(box.min_point - point, point - box.max_point), Vec4f());
+    return outside.dotProductWith(outside);
+}
 
-// BVH_Tree::~BVH_Tree(){
-//     deleteTree(head);
-// }
+float BVH_Tree::squaredDistanceBound(const Vec4f& point) const {
+    float nearest = FLT_MAX;
+    vector<const Node*> stack(1, head);
+    while (!stack.empty()){
+        const Node* node = stack.back();
+        stack.pop_back();
+        if (squaredDistanceToBox(node->bbox, point) >= nearest){
+            continue;
+        }
+        if (node->is_leaf){
+            nearest = squaredDistanceToBox(node->bbox, point);
+            continue;
+        }
+        for (const Node* child : {node->left, node->right}){
+            if (child){
+                stack.push_back(child);
+            }
+        }
+    }
+    return nearest;
+}
 
 // void BVH_Tree::print_main(){
 //     this->head->print_tree();
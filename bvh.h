@@ -6,6 +6,10 @@
 #include "ray.h"
 #include "bbox.h"
 #include "node.h"
+#include "kernels.h"
+#include "stats.h"
+#include "tlas.h"
+#include <chrono>
 
 using std::vector;
 using std::min;
@@ -17,17 +21,45 @@ using parser::Vec3f;
 
 class BVH_Tree{
     public:
+        Arena arena;                    // owns every node and the primitive arrays, released with the tree
         Node* head;
+        WideBVH wide;                   // quantized copy traversal uses instead of head, when built
+        BuildStats build_stats;
+        BVHSettings settings;
+        bool backface_culling;
+        vector<BottomLevelBVH> bottom_levels;   // two-level trees only, linked under head by a top level in arena
+        const Triangle* triangle_base;  // the scene arrays the primitive lists point into
+        const Sphere* sphere_base;
+        const KernelSet* kernels;
+        KernelSet::ClosestHitKernel closest_hit_kernel;
+        KernelSet::AnyHitKernel any_hit_kernel;
+        KernelSet::WideClosestHitKernel wide_closest_hit_kernel;
+        KernelSet::WideAnyHitKernel wide_any_hit_kernel;
 
-        BVH_Tree(Scene& scene);
-
-        /* Prevents memory leak but decreases speed */
-        // ~BVH_Tree();
-        // void deleteTree(Node* node);
+        BVH_Tree(Scene& scene, const KernelSet& kernels, const BVHSettings& settings = BVHSettings(), bool backface_culling_enabled = true);
 
         void configureHead(Scene& scene);
+        void buildBottomLevel(BottomLevelBVH& bottom, Scene& scene);
+        void optimizeBottomLevel(BottomLevelBVH& bottom, float time_budget);
+        /* Top level over the bottom-level trees and one instance leaf per mesh instance */
+        void linkTopLevel(const Scene& scene);
+        void finishTree(std::chrono::steady_clock::time_point start);
+        /* Rebuilds the bottom-level trees of the given meshes of a two-level tree, whose triangles may
+           have moved but keep their ranges, and everything derived from the whole tree. scene may be
+           another Scene object of the same layout; the other trees are pointed at its arrays. The top
+           level is freed, so nodes held from before, such as ThreadContext::last_occluders, must be reset. */
+        void rebuildMeshes(Scene& scene, const vector<int>& meshes);
+        /* Closest hits of ray_count pseudo-random rays inside the root box that differ from reference's
+           in distance or material, to check a rebuilt tree against a fresh build */
+        long countMismatches(const BVH_Tree& reference, int ray_count) const ;
+        void measure(const Node* node, int depth);
+        void selectKernels(const Scene& scene, const KernelSet& kernel_set, bool backface_culling_enabled);
         void print_main();
-        ClosestIntersectedObjectInfo getIntersectInfo(const Ray& r, bool backface_culling_enabled) const ;
+        ClosestIntersectedObjectInfo getIntersectInfo(const Ray& r) const ;
+        bool isOccluded(const Ray& r, float t_max) const ;
+        bool isOccluded(const Ray& r, float t_max, const Node*& last_occluder, RenderStats& stats) const ;
+        /* Lower bound on the squared distance from point to any primitive: the distance to the nearest leaf box */
+        float squaredDistanceBound(const Vec4f& point) const ;
 };
 
 #endif
\ No newline at end of file
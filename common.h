@@ -2,47 +2,100 @@
 #define __HW1__COMMON__
 
 #include "parser.h"
+#include "vecmath.h"
 #include <variant>
 #include <algorithm> 
 
-struct RGB{
-    int r, g, b;
+/* Linear radiance in 8-bit display units, accumulated in float without rounding.
+   Quantized once per image by the pack kernel. */
+struct alignas(16) RGB{
+    Float4 data;
 
-    RGB(int r, int g, int b): r(r), g(g), b(b) {}
+    RGB(): data(0.0f) {}
 
-    RGB(const parser::Vec3i& intvec) : r(intvec.x), g(intvec.y), b(intvec.z) {}
+    RGB(float r, float g, float b): data(r, g, b, 0.0f) {}
 
-    RGB(const parser::Vec3f& floatvec) : r(std::round(floatvec.x)), g(std::round(floatvec.y)), b(std::round(floatvec.z)) {}
+    RGB(const parser::Vec3i& intvec) : data(intvec.x, intvec.y, intvec.z, 0.0f) {}
+
+    RGB(const parser::Vec3f& floatvec) : data(floatvec.x, floatvec.y, floatvec.z, 0.0f) {}
+
+    RGB(const Vec4f& floatvec) : data(floatvec.data) {}
+
+    explicit RGB(const Float4& data) : data(data) {}
+
+    inline float r() const { return data[0]; }
+    inline float g() const { return data[1]; }
+    inline float b() const { return data[2]; }
 
     inline RGB operator+(const RGB& color) const {
-        return RGB(r + color.r, g + color.g, b + color.b);
+        return RGB(data + color.data);
     }
 
     inline RGB operator-(const RGB& color) const {
-        return RGB(r - color.r, g - color.g, b - color.b);
+        return RGB(data - color.data);
     }
 
     inline RGB operator*(float mult) const {
-        return RGB(r * mult, g * mult, b * mult);
+        return RGB(data * Float4(mult));
+    }
+
+    inline RGB operator*(const RGB& color) const {
+        return RGB(data * color.data);
     }
 
     inline RGB operator*(const parser::Vec3f& vec) const {
-        return RGB(r * vec.x, g * vec.y, b * vec.z);
+        return RGB(data * Vec4f(vec).data);
     }
 
     friend std::ostream& operator<<(std::ostream& os, const RGB& color) {
-        os << "Color(" << color.r << ", " << color.g << ", " << color.b << ")";
+        os << "Color(" << color.r() << ", " << color.g() << ", " << color.b() << ")";
 
         return os;
     }
+};
 
-    inline void truncate() {
-        r = std::max(0, std::min(r, 255));
-        g = std::max(0, std::min(g, 255));
-        b = std::max(0, std::min(b, 255));
-    }
+/* Scene-wide shading switches chosen on the command line */
+struct ShadingSettings{
+    bool cull_shadow_rays;
+    float shadow_cull_threshold;    // in 8-bit levels, after throughput and clamping
+    bool use_light_bvh;
+    float light_error_budget;       // in 8-bit levels per hit, 0 only drops lights behind the surface
+    bool settle_paths;              // ends mirror paths whose remaining bounces cannot change the 8-bit color, see Ray::isPathSettled
+    bool float_output;              // the float framebuffer is written too, so channels past display white still count
+
+    ShadingSettings(): cull_shadow_rays(false), shadow_cull_threshold(0.5f), use_light_bvh(false), light_error_budget(0.5f),
+        settle_paths(false), float_output(false) {}
 };
 
+/* How the BVH is built, chosen on the command line */
+enum class BVHBuilder { MEDIAN, LINEAR, SPATIAL };
+
+enum class NodeLayout { BUILD, DEPTH_FIRST, VAN_EMDE_BOAS, CLUSTERED };    // order of the nodes in memory, see layoutNodes
+
+struct BVHSettings{
+    BVHBuilder builder;
+    bool morton_presort;            // median builder: orders the primitive arrays along a Z-order curve before splitting
+    int morton_bits;                // linear builder: 30 or 63 bit codes
+    float duplication_budget;       // spatial builder: extra references allowed, as a fraction of the primitives
+    bool optimize_treelets;         // rearranges small subtrees to lower their surface area after building
+    float treelet_time_budget;      // seconds after which no further treelet is rearranged
+    NodeLayout layout;
+    bool wide_nodes;                // traverses a quantized 4-wide copy of the tree, see WideNode
+    bool two_level;                 // one tree per mesh and one for the rest, under a top-level tree
+
+    BVHSettings(): builder(BVHBuilder::MEDIAN), morton_presort(false), morton_bits(63), duplication_budget(0.3f), optimize_treelets(false),
+        treelet_time_budget(1.0f), layout(NodeLayout::BUILD), wide_nodes(false), two_level(false) {}
+};
+
+/* Template parameters of the traversal and leaf kernels, fixed once per scene */
+enum class CullingMode { NONE, BACKFACE };
+
+enum class QueryType { CLOSEST_HIT, ANY_HIT };
+
+enum class PrimitiveSet { TRIANGLES_ONLY, SPHERES_ONLY, MIXED };
+
+enum class ReferenceMode { UNIQUE, DUPLICATED };     // whether a primitive can sit in several leaves
+
 struct intersectionInfo{
     bool isIntersected;
     float t;
@@ -54,20 +107,35 @@ struct intersectionInfo{
 struct ClosestIntersectedObjectInfo{
     bool isIntersectedWithAnyObject;
     int material_id;
-    parser::Vec3f unit_normal_vector;
-    parser::Vec3f intersection_point;
+    const void* primitive;          // the triangle or sphere hit, tells surfaces apart across rays
+    UnitVec4f unit_normal_vector;
+    Vec4f intersection_point;
     float t;
+    const void* instance;           // the mesh instance the primitive was hit through, NULL outside instances
 
-    ClosestIntersectedObjectInfo(parser::Triangle* triangle, float t, parser::Vec3f& intersection_point):
-        isIntersectedWithAnyObject(true), material_id(triangle->material_id), t(t), intersection_point(intersection_point) {
-        unit_normal_vector = triangle->unit_normal_vector;
+    ClosestIntersectedObjectInfo(const parser::Triangle* triangle, float t, const Vec4f& intersection_point):
+        isIntersectedWithAnyObject(true), material_id(triangle->material_id), primitive(triangle), t(t), intersection_point(intersection_point), instance(NULL) {
+        unit_normal_vector = UnitVec4f::assumeNormalized(triangle->unit_normal_vector);
     }
-    ClosestIntersectedObjectInfo(parser::Sphere* sphere, float t, parser::Vec3f& intersection_point):
-        isIntersectedWithAnyObject(true), material_id(sphere->material_id), t(t), intersection_point(intersection_point) {
-        unit_normal_vector = (intersection_point - sphere->center).getUnitVector();
+    ClosestIntersectedObjectInfo(const parser::Sphere* sphere, float t, const Vec4f& intersection_point):
+        isIntersectedWithAnyObject(true), material_id(sphere->material_id), primitive(sphere), t(t), intersection_point(intersection_point), instance(NULL) {
+        unit_normal_vector = UnitVec4f::normalize(intersection_point - Vec4f(sphere->center));
     }
-    ClosestIntersectedObjectInfo(bool isIntersected): isIntersectedWithAnyObject(false), t(-1) {}
-    ClosestIntersectedObjectInfo(): isIntersectedWithAnyObject(false), t(-1) {}
+    ClosestIntersectedObjectInfo(bool isIntersected): isIntersectedWithAnyObject(false), primitive(NULL), t(-1), instance(NULL) {}
+    ClosestIntersectedObjectInfo(): isIntersectedWithAnyObject(false), primitive(NULL), t(-1), instance(NULL) {}
+};
+
+/* The surface a ray hits, or none: instances of a mesh share its primitives, so the primitive
+   alone would not tell two copies apart */
+struct SurfaceId{
+    const void* primitive;
+    const void* instance;
+
+    SurfaceId(): primitive(NULL), instance(NULL) {}
+    explicit SurfaceId(const ClosestIntersectedObjectInfo& info): primitive(info.primitive), instance(info.instance) {}
+
+    bool operator==(const SurfaceId& other) const { return primitive == other.primitive && instance == other.instance; }
+    bool operator!=(const SurfaceId& other) const { return !(*this == other); }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef __HW1__CONTEXT__
+#define __HW1__CONTEXT__
+
+#include <vector>
+#include <cstdint>
+#include "parser.h"
+#include "common.h"
+#include "stats.h"
+
+class BVH_Tree;
+class LightBVH;
+class Node;
+
+/* Read-only state shared by every render thread of a scene */
+struct RenderContext{
+    const BVH_Tree& tree;
+    const parser::Scene& scene;
+    ShadingSettings settings;
+    const LightBVH* light_bvh;          // null when every light is shaded at every hit
+    std::vector<RGB> path_radiance;     // per bounce, bound on what the rest of a path adds per unit throughput, see Ray::pathRadianceBounds
+
+    RenderContext(const BVH_Tree& tree, const parser::Scene& scene, const ShadingSettings& settings, const LightBVH* light_bvh = NULL):
+        tree(tree), scene(scene), settings(settings), light_bvh(light_bvh) {}
+};
+
+/* Mutable state owned by one render thread */
+struct ThreadContext{
+    RenderStats stats;
+    std::vector<int> light_ids;         // lights selected for the hit being shaded
+    std::vector<const Node*> last_occluders;    // per light, the leaf that blocked its last shadow ray
+    const uint64_t* shadow_visibility;          // recorded bit per light for the hit being shaded, NULL traces shadow rays
+
+    ThreadContext(int max_recursion_depth = 0, int light_count = 0):
+        stats(max_recursion_depth), last_occluders(light_count, (const Node*)NULL), shadow_visibility(NULL) {}
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include "deferred.h"
+#include "bvh.h"
+#include "gbuffer.h"
+
+void renderDeferred(const RenderContext& context, ThreadContext& thread, std::vector<Ray>& rays, std::vector<int>& pixels, RGB* framebuffer){
+    const parser::Scene& scene = context.scene;
+    const BVH_Tree& tree = context.tree;
+    RenderStats& stats = thread.stats;
+
+    std::vector<RGB> throughputs(rays.size(), RGB(1, 1, 1));
+    std::vector<ClosestIntersectedObjectInfo> hits;
+    std::vector<int> hit_rays;
+    std::vector<int> slots;
+    std::vector<int> material_starts;
+    std::vector<RGB> lights;
+    GBuffer gbuffer;
+
+    stats.primary_rays += rays.size();
+    for (int pixel : pixels){
+        framebuffer[pixel] = RGB(0, 0, 0);
+    }
+
+    for (int bounce = 0; bounce <= scene.max_recursion_depth && !rays.empty(); bounce++){
+        /* Trace pass */
+        hits.clear();
+        hit_rays.clear();
+        material_starts.assign(scene.materials.size() + 2, 0);
+        for (size_t k = 0; k < rays.size(); k++){
+            ClosestIntersectedObjectInfo objectInfo = tree.getIntersectInfo(rays[k]);
+            if (!objectInfo.isIntersectedWithAnyObject){
+                if (bounce == 0){
+                    framebuffer[pixels[k]] = RGB(scene.background_color);
+                }
+                stats.path_bounces[bounce]++;
+                continue;
+            }
+            hits.push_back(objectInfo);
+            hit_rays.push_back(k);
+            material_starts[objectInfo.material_id + 1]++;
+        }
+
+        /* Counting sort by material id into the G-buffer */
+        for (size_t m = 1; m < material_starts.size(); m++){
+            material_starts[m] += material_starts[m - 1];
+        }
+        std::vector<int> next_slot(material_starts.begin(), material_starts.end() - 1);
+        gbuffer.resize(hits.size());
+        slots.resize(hits.size());
+        for (size_t h = 0; h < hits.size(); h++){
+            const Ray& ray = rays[hit_rays[h]];
+            int slot = next_slot[hits[h].material_id]++;
+            slots[slot] = h;
+            gbuffer.set(slot, hits[h].intersection_point, hits[h].unit_normal_vector, UnitVec4f::normalize(-ray.direction),
+                        hits[h].material_id, pixels[hit_rays[h]], throughputs[hit_rays[h]]);
+        }
+
+        /* Shading pass, one material at a time */
+        lights.resize(hits.size());
+        for (size_t m = 1; m <= scene.materials.size(); m++){
+            int begin = material_starts[m];
+            int end = material_starts[m + 1];
+            if (begin == end){
+                continue;
+            }
+            const parser::Material& material = scene.materials[m - 1];
+            RGB ambient = Ray::computeAmbientColor(material, scene.ambient_light);
+            for (int slot = begin; slot < end; slot++){
+                gbuffer.path_colors[slot] = framebuffer[gbuffer.pixels[slot]] + ambient * gbuffer.throughputs[slot];
+            }
+
+            if (context.light_bvh){
+                /* Light selection differs per hit, so these hits go through the inline kernel */
+                for (int slot = begin; slot < end; slot++){
+                    const ClosestIntersectedObjectInfo& objectInfo = hits[slots[slot]];
+                    Ray::selectLights(context, thread, objectInfo, material, gbuffer.throughputs[slot], gbuffer.path_colors[slot]);
+                    lights[slot] = tree.kernels->shade_point_lights(context, objectInfo, material, gbuffer.view(slot),
+                                                                    gbuffer.throughputs[slot], gbuffer.path_colors[slot], thread);
+                }
+            }
+            else{
+                tree.kernels->shade_hits(context, gbuffer, begin, end, material, thread, lights.data());
+            }
+
+            for (int slot = begin; slot < end; slot++){
+                RGB& color = framebuffer[gbuffer.pixels[slot]];
+                color = color + (ambient + lights[slot]) * gbuffer.throughputs[slot];
+            }
+        }
+
+        /* Mirror rays of the next bounce */
+        std::vector<Ray> next_rays;
+        std::vector<int> next_pixels;
+        std::vector<RGB> next_throughputs;
+        for (int slot = 0; slot < gbuffer.size(); slot++){
+            const parser::Material& material = scene.materials[gbuffer.material_ids[slot] - 1];
+            RGB throughput = gbuffer.throughputs[slot];
+            if (!Ray::continuePath(context, material, framebuffer[gbuffer.pixels[slot]], throughput, bounce, stats)){
+                continue;
+            }
+            next_rays.push_back(Ray::reflect(gbuffer.position(slot), gbuffer.normal(slot), gbuffer.view(slot), scene.shadow_ray_epsilon));
+            next_pixels.push_back(gbuffer.pixels[slot]);
+            next_throughputs.push_back(throughput);
+        }
+        rays.swap(next_rays);
+        pixels.swap(next_pixels);
+        throughputs.swap(next_throughputs);
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef __HW1__DEFERRED__
+#define __HW1__DEFERRED__
+
+#include <vector>
+#include "common.h"
+#include "ray.h"
+#include "context.h"
+
+/* Deferred counterpart of Ray::getcolor for a batch of camera rays, typically one tile.
+   Every bounce first traces all live rays into a GBuffer sorted by material, then shades
+   each material's hits in one kernel call, then spawns the mirror rays of the next bounce.
+   Writes the final color of pixels[k] for every rays[k]; both vectors are consumed. */
+void renderDeferred(const RenderContext& context, ThreadContext& thread, std::vector<Ray>& rays, std::vector<int>& pixels, RGB* framebuffer);
+
+#endif
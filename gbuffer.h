@@ -0,0 +1,57 @@
+#ifndef __HW1__GBUFFER__
+#define __HW1__GBUFFER__
+
+#include <vector>
+#include "common.h"
+#include "vecmath.h"
+
+/* Hits of one tile and bounce for the deferred shading pass, in structure-of-arrays form
+   so the shade kernel can load four hits per register. Hits are stored grouped by material;
+   the float arrays carry three slots of padding so the last batch can be loaded whole. */
+struct GBuffer{
+    std::vector<float> position_x, position_y, position_z;
+    std::vector<float> normal_x, normal_y, normal_z;
+    std::vector<float> view_x, view_y, view_z;       // unit vector from the hit back along the incoming ray
+    std::vector<int> material_ids;
+    std::vector<int> pixels;
+    std::vector<RGB> throughputs;
+    std::vector<RGB> path_colors;                       // pixel color before this hit, plus its ambient term
+
+    inline int size() const {
+        return material_ids.size();
+    }
+
+    void resize(int count){
+        std::vector<float>* floats[] = {&position_x, &position_y, &position_z, &normal_x, &normal_y, &normal_z, &view_x, &view_y, &view_z};
+        for (std::vector<float>* array : floats){
+            array->assign(count + 3, 0.0f);
+        }
+        material_ids.resize(count);
+        pixels.resize(count);
+        throughputs.resize(count);
+        path_colors.resize(count);
+    }
+
+    void set(int i, const Vec4f& position, const UnitVec4f& normal, const UnitVec4f& view, int material_id, int pixel, const RGB& throughput){
+        position_x[i] = position.x(); position_y[i] = position.y(); position_z[i] = position.z();
+        normal_x[i] = normal.x(); normal_y[i] = normal.y(); normal_z[i] = normal.z();
+        view_x[i] = view.x(); view_y[i] = view.y(); view_z[i] = view.z();
+        material_ids[i] = material_id;
+        pixels[i] = pixel;
+        throughputs[i] = throughput;
+    }
+
+    inline Vec4f position(int i) const {
+        return Vec4f(position_x[i], position_y[i], position_z[i]);
+    }
+
+    inline UnitVec4f normal(int i) const {
+        return UnitVec4f::assumeNormalized(Vec4f(normal_x[i], normal_y[i], normal_z[i]));
+    }
+
+    inline UnitVec4f view(int i) const {
+        return UnitVec4f::assumeNormalized(Vec4f(view_x[i], view_y[i], view_z[i]));
+    }
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "instance.h"
+
+Node* createInstanceNode(const parser::MeshInstance& mesh_instance, const Node* root, Arena& arena){
+    const float (*m)[4] = mesh_instance.transform;
+    /* Inverse of the 3x3 part by cofactors; the parser rejects transforms that are not invertible */
+    float cofactors[3][3];
+    for (int i = 0; i < 3; i++){
+        for (int j = 0; j < 3; j++){
+            int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+            int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+            cofactors[i][j] = m[i1][j1] * m[i2][j2] - m[i1][j2] * m[i2][j1];
+        }
+    }
+    float determinant = m[0][0] * cofactors[0][0] + m[0][1] * cofactors[0][1] + m[0][2] * cofactors[0][2];
+    float inverse[3][3];                // inverse[i][j] = cofactors[j][i] / determinant
+    for (int i = 0; i < 3; i++){
+        for (int j = 0; j < 3; j++){
+            inverse[i][j] = cofactors[j][i] / determinant;
+        }
+    }
+
+    Instance* instance = arena.create<Instance>();
+    for (int j = 0; j < 3; j++){
+        instance->to_object[j] = Vec4f(inverse[0][j], inverse[1][j], inverse[2][j]);
+        /* Column j of the inverse transpose is row j of the inverse */
+        instance->normal_to_world[j] = Vec4f(inverse[j][0], inverse[j][1], inverse[j][2]);
+    }
+    Vec4f translation(m[0][3], m[1][3], m[2][3]);
+    instance->to_object[3] = -(instance->to_object[0] * translation.x() + instance->to_object[1] * translation.y()
+                               + instance->to_object[2] * translation.z());
+    instance->root = root;
+    instance->material_id = mesh_instance.material_id;
+
+    Node* node = arena.create<Node>();
+    node->is_leaf = true;
+    node->instance = instance;
+    node->bbox.min_point = Vec3f::MAXVEC;
+    node->bbox.max_point = Vec3f::MINVEC;
+    for (int corner = 0; corner < 8; corner++){
+        Vec4f point((corner & 1 ? root->bbox.max_point : root->bbox.min_point).x(),
+                    (corner & 2 ? root->bbox.max_point : root->bbox.min_point).y(),
+                    (corner & 4 ? root->bbox.max_point : root->bbox.min_point).z());
+        Vec4f world(m[0][0] * point.x() + m[0][1] * point.y() + m[0][2] * point.z() + m[0][3],
+                    m[1][0] * point.x() + m[1][1] * point.y() + m[1][2] * point.z() + m[1][3],
+                    m[2][0] * point.x() + m[2][1] * point.y() + m[2][2] * point.z() + m[2][3]);
+        node->bbox.min_point = Vec4f::min(node->bbox.min_point, world);
+        node->bbox.max_point = Vec4f::max(node->bbox.max_point, world);
+    }
+    return node;
+}
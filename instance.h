@@ -0,0 +1,36 @@
+#ifndef __HW1__INSTANCE__
+#define __HW1__INSTANCE__
+
+#include "node.h"
+#include "arena.h"
+#include "vecmath.h"
+
+/* A mesh's bottom-level tree placed in the world by an affine transform. Rays are taken into
+   the tree's object space instead of copying its triangles, so every instance shares one tree.
+   Matrices are stored by columns, the translation in the last one, so that a transform is
+   three multiply-adds over whole vectors. */
+struct Instance{
+    Vec4f to_object[4];                 // inverse of the instance transform
+    Vec4f normal_to_world[3];           // inverse transpose of its 3x3 part
+    const Node* root;                   // the base mesh's tree, in object space
+    int material_id;                    // replaces the base mesh's material, -1 keeps it
+
+    inline Vec4f pointToObject(const Vec4f& point) const {
+        return to_object[0] * point.x() + to_object[1] * point.y() + to_object[2] * point.z() + to_object[3];
+    }
+
+    /* Not normalized, so distances along the ray stay those of the world ray */
+    inline Vec4f directionToObject(const Vec4f& direction) const {
+        return to_object[0] * direction.x() + to_object[1] * direction.y() + to_object[2] * direction.z();
+    }
+
+    inline UnitVec4f normalToWorld(const Vec4f& normal) const {
+        return UnitVec4f::normalize(normal_to_world[0] * normal.x() + normal_to_world[1] * normal.y() + normal_to_world[2] * normal.z());
+    }
+};
+
+/* Leaf of the top-level tree for one mesh instance over the tree at root, with the world box of
+   the root box's transformed corners. The Instance lives in arena next to the node. */
+Node* createInstanceNode(const parser::MeshInstance& mesh_instance, const Node* root, Arena& arena);
+
+#endif
@@ -0,0 +1,41 @@
+#include "bvh.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#define KERNEL_NAMESPACE generic_kernel_impl
+#define KERNEL_SET generic_kernels
+#define KERNEL_SET_NAME "generic"
+#include "kernels.inl"
+
+std::vector<const KernelSet*> supportedKernelSets(){
+    std::vector<const KernelSet*> kernel_sets;
+    kernel_sets.push_back(&generic_kernels);
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")){
+        kernel_sets.push_back(&sse4_kernels);
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("bmi2")){
+        kernel_sets.push_back(&avx2_kernels);
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")
+            && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq")){
+            kernel_sets.push_back(&avx512_kernels);
+        }
+    }
+#endif
+    return kernel_sets;
+}
+
+const KernelSet& selectKernelSet(const std::string& requested){
+    std::vector<const KernelSet*> kernel_sets = supportedKernelSets();
+    if (requested == "auto"){
+        return *kernel_sets.back();
+    }
+    for (const KernelSet* kernel_set: kernel_sets){
+        if (requested == kernel_set->name){
+            return *kernel_set;
+        }
+    }
+    throw std::runtime_error("Error: Kernel variant " + requested + " is unknown or not supported by this CPU.");
+}
@@ -0,0 +1,66 @@
+#ifndef __HW1__KERNELS__
+#define __HW1__KERNELS__
+
+#include <string>
+#include <vector>
+#include "parser.h"
+#include "common.h"
+#include "ray.h"
+#include "node.h"
+#include "wide.h"
+#include "instance.h"
+#include "context.h"
+#include "gbuffer.h"
+
+/* Hot kernels compiled once per instruction set (kernels.inl) and selected at startup */
+struct KernelSet{
+    typedef bool (*ClosestHitKernel)(const Node* head, const Ray& r, ClosestIntersectedObjectInfo& hitInfo);
+    typedef const Node* (*AnyHitKernel)(const Node* head, const Ray& r, float t_max);     // blocking leaf or NULL
+    typedef bool (*WideClosestHitKernel)(const WideBVH& bvh, const Ray& r, ClosestIntersectedObjectInfo& hitInfo);
+    typedef const Node* (*WideAnyHitKernel)(const WideBVH& bvh, const Ray& r, float t_max);
+    typedef RGB (*ShadeKernel)(const RenderContext& context, const ClosestIntersectedObjectInfo& hitInfo, const parser::Material& material,
+                               const UnitVec4f& w_camera, const RGB& throughput, const RGB& path_color, ThreadContext& thread);
+    typedef void (*ShadeHitsKernel)(const RenderContext& context, const GBuffer& hits, int begin, int end,
+                                    const parser::Material& material, ThreadContext& thread, RGB* lights);
+    typedef void (*PackKernel)(const RGB* colors, int count, unsigned char* pixels);
+
+    const char* name;
+    ClosestHitKernel closest_hit[2][2][3];  // [ReferenceMode][CullingMode][PrimitiveSet]
+    AnyHitKernel any_hit[2][3];             // [ReferenceMode][PrimitiveSet], shadow rays never cull
+    WideClosestHitKernel wide_closest_hit[2][2][3];     // same over the quantized wide nodes
+    WideAnyHitKernel wide_any_hit[2][3];
+    ShadeKernel shade_point_lights;
+    ShadeHitsKernel shade_hits;
+    PackKernel pack_pixels;
+
+    inline ClosestHitKernel closestHit(CullingMode culling, PrimitiveSet primitives, ReferenceMode references) const {
+        return closest_hit[static_cast<int>(references)][static_cast<int>(culling)][static_cast<int>(primitives)];
+    }
+
+    inline AnyHitKernel anyHit(PrimitiveSet primitives, ReferenceMode references) const {
+        return any_hit[static_cast<int>(references)][static_cast<int>(primitives)];
+    }
+
+    inline WideClosestHitKernel wideClosestHit(CullingMode culling, PrimitiveSet primitives, ReferenceMode references) const {
+        return wide_closest_hit[static_cast<int>(references)][static_cast<int>(culling)][static_cast<int>(primitives)];
+    }
+
+    inline WideAnyHitKernel wideAnyHit(PrimitiveSet primitives, ReferenceMode references) const {
+        return wide_any_hit[static_cast<int>(references)][static_cast<int>(primitives)];
+    }
+};
+
+extern const KernelSet generic_kernels;
+#if defined(__x86_64__) || defined(__i386__)
+extern const KernelSet sse4_kernels;
+extern const KernelSet avx2_kernels;
+extern const KernelSet avx512_kernels;
+#endif
+
+/* Variants the running CPU can execute, best last */
+std::vector<const KernelSet*> supportedKernelSets();
+
+/* "auto" picks the best supported variant, anything else must name a supported one */
+const KernelSet& selectKernelSet(const std::string& requested);
+
+#endif
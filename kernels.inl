@@ -0,0 +1,621 @@
+/* Kernel bodies shared by every instruction set variant.
+   Included by kernels_<isa>.cpp after its target pragma, with KERNEL_NAMESPACE,
+   KERNEL_SET and KERNEL_SET_NAME defined. Must not include headers itself. */
+
+namespace KERNEL_NAMESPACE {
+
+using parser::Vec3f;
+using parser::Triangle;
+using parser::Sphere;
+
+/* Both slabs of all three axes in one pass. Axes the ray runs parallel to never
+   clip the interval, which keeps the behaviour of the original per-axis test. */
+static inline bool slabTest(const BBox& bbox, const Ray& ray) {
+    if (ray.direction == Vec4f()){
+        return false;
+    }
+
+    Float4 t_min = (bbox.min_point.data - ray.start_position.data) / ray.direction.data;
+    Float4 t_max = (bbox.max_point.data - ray.start_position.data) / ray.direction.data;
+    Float4 parallel = Float4::equalMask(ray.direction.data, Float4(0.0f));
+    Vec4f t_enter = Vec4f(Float4::select(parallel, Float4(FLT_MIN), Float4::min(t_min, t_max)));
+    Vec4f t_exit = Vec4f(Float4::select(parallel, Float4(FLT_MAX), Float4::max(t_min, t_max)));
+
+    float t_enter_largest = t_enter.maxComponent();
+    float t_exit_smallest = t_exit.minComponent();
+    return (t_enter_largest <= t_exit_smallest) && t_exit_smallest >= 0;
+}
+
+/* Cramer's rule written as triple products: each determinant is a dot with a cross product */
+static inline intersectionInfo intersectTriangle(const Ray& ray, const Triangle& triangle) {
+    float epsilon = 1e-5;
+
+    Vec4f vertex_a = triangle.a;
+    Vec4f a = vertex_a - Vec4f(triangle.b);
+    Vec4f b = vertex_a - Vec4f(triangle.c);
+    Vec4f r = vertex_a - ray.start_position;
+
+    Vec4f b_cross_d = b.crossProductWith(ray.direction);
+    float determinant = a.dotProductWith(b_cross_d);
+
+    if (determinant == 0) {
+        return intersectionInfo(false);
+    }
+
+    float beta = r.dotProductWith(b_cross_d) / determinant;
+    float gamma = a.dotProductWith(r.crossProductWith(ray.direction)) / determinant;
+    float t = a.dotProductWith(b.crossProductWith(r)) / determinant;
+
+    if (beta >= -epsilon && gamma >= -epsilon && beta + gamma <= 1 + epsilon) {
+        return intersectionInfo(true, t);
+    }
+
+    return intersectionInfo(false);
+}
+
+static inline intersectionInfo intersectSphere(const Ray& ray, const Sphere& sphere) {
+    Vec4f tmpvec = ray.start_position - Vec4f(sphere.center);
+    float dirDotDir = ray.direction.dotProductWith(ray.direction);
+    float tmpDotDir = ray.direction.dotProductWith(tmpvec);
+    float tmpDotTmp = tmpvec.dotProductWith(tmpvec);
+
+    float discriminant = tmpDotDir * tmpDotDir - dirDotDir * (tmpDotTmp - sphere.radius * sphere.radius);
+
+    if (discriminant < 0) {
+        return intersectionInfo(false);
+    }
+
+    float sqrtDiscriminant = std::sqrt(discriminant);
+    float t = (-tmpDotDir - sqrtDiscriminant) / dirDotDir;
+
+    return intersectionInfo(true, t);
+}
+
+/* Primitives a ray was recently tested against, direct mapped by address. Trees with spatial
+   splits put a primitive in every leaf it overlaps, and a ray crossing several of them then
+   tests it once; a slot taken over by another primitive only costs a repeated test. Cleared
+   on first use, so rays that meet no such leaf pay nothing. */
+struct Mailbox{
+    static const unsigned int SIZE = 16;
+    const void* slots[SIZE];
+    bool cleared;
+
+    Mailbox(): cleared(false) {}
+
+    /* False if primitive was tested already, otherwise records it */
+    inline bool visit(const void* primitive) {
+        if (!cleared){
+            std::fill(slots, slots + SIZE, static_cast<const void*>(NULL));
+            cleared = true;
+        }
+        const void*& slot = slots[(reinterpret_cast<uintptr_t>(primitive) >> 6) % SIZE];
+        if (slot == primitive){
+            return false;
+        }
+        slot = primitive;
+        return true;
+    }
+};
+
+template <CullingMode Culling, QueryType Query, PrimitiveSet Primitives, ReferenceMode References>
+static bool intersectNode(const Node* node, const Ray& ray, ClosestIntersectedObjectInfo& hitInfo, float t_max, Mailbox& mailbox);
+
+/* The instance's tree, traversed with the ray in its object space. The object ray keeps the world
+   ray's parameter, so t needs no conversion; the hit point is taken on the world ray rather than
+   transformed back. Back faces are still told apart there, as the dot product of the object
+   direction and normal has the sign of the world one. The base mesh's tree shares its primitives
+   with this one, so the mailbox starts empty. */
+template <CullingMode Culling, QueryType Query, PrimitiveSet Primitives, ReferenceMode References>
+static bool intersectInstance(const Instance& instance, const Ray& ray, ClosestIntersectedObjectInfo& hitInfo, float t_max) {
+    Ray object_ray(instance.pointToObject(ray.start_position), instance.directionToObject(ray.direction));
+    Mailbox mailbox;
+    if (!intersectNode<Culling, Query, Primitives, References>(instance.root, object_ray, hitInfo, t_max, mailbox)){
+        return false;
+    }
+    if (Query == QueryType::CLOSEST_HIT){
+        hitInfo.intersection_point = ray.start_position + ray.direction * hitInfo.t;
+        hitInfo.unit_normal_vector = instance.normalToWorld(hitInfo.unit_normal_vector);
+        if (instance.material_id >= 0){
+            hitInfo.material_id = instance.material_id;
+        }
+        hitInfo.instance = &instance;
+    }
+    return true;
+}
+
+template <CullingMode Culling, QueryType Query, PrimitiveSet Primitives, ReferenceMode References>
+static bool intersectLeaf(const Node& node, const Ray& ray, ClosestIntersectedObjectInfo& hitInfo, float t_max, Mailbox& mailbox) {
+    if (node.instance){
+        return intersectInstance<Culling, Query, Primitives, References>(*node.instance, ray, hitInfo, t_max);
+    }
+
+    const Triangle* closestTriangle;
+    const Sphere* closestSphere;
+    float min_t = t_max;
+    bool found = false;
+    bool sphere_found = false;
+
+    if (Primitives != PrimitiveSet::SPHERES_ONLY){
+        for (const Triangle* triangle: node.triangles){ 
+            if (Culling == CullingMode::BACKFACE && ray.direction.dotProductWith(triangle->unit_normal_vector) >= 0){
+                continue;
+            }
+            if (References == ReferenceMode::DUPLICATED && node.has_duplicates && !mailbox.visit(triangle)){
+                continue;
+            }
+            intersectionInfo intersectionInfo = intersectTriangle(ray, *triangle);
+            if(intersectionInfo.isIntersected && intersectionInfo.t < min_t && intersectionInfo.t > 0){
+                if (Query == QueryType::ANY_HIT){
+                    hitInfo.isIntersectedWithAnyObject = true;
+                    hitInfo.t = intersectionInfo.t;
+                    return true;
+                }
+                closestTriangle = triangle;
+                min_t = intersectionInfo.t;
+                found = true;
+            }
+        }
+    }
+    if (Primitives != PrimitiveSet::TRIANGLES_ONLY){
+        for (const Sphere* sphere: node.spheres){
+            if (Culling == CullingMode::BACKFACE && ray.direction.dotProductWith(ray.start_position - sphere->center) >= 0){
+                continue;
+            }
+            if (References == ReferenceMode::DUPLICATED && node.has_duplicates && !mailbox.visit(sphere)){
+                continue;
+            }
+            intersectionInfo intersectionInfo = intersectSphere(ray, *sphere);
+            if(intersectionInfo.isIntersected && intersectionInfo.t < min_t && intersectionInfo.t > 0){
+                if (Query == QueryType::ANY_HIT){
+                    hitInfo.isIntersectedWithAnyObject = true;
+                    hitInfo.t = intersectionInfo.t;
+                    return true;
+                }
+                closestSphere = sphere;
+                min_t = intersectionInfo.t;
+                found = true;
+                sphere_found = true;
+            }
+        }
+    }
+    if (!found){
+        hitInfo = ClosestIntersectedObjectInfo(false);
+        return false;
+    }
+
+    Vec4f intersection_point = ray.start_position + ray.direction * min_t;
+    if (sphere_found) hitInfo = ClosestIntersectedObjectInfo(closestSphere, min_t, intersection_point);
+    else hitInfo = ClosestIntersectedObjectInfo(closestTriangle, min_t, intersection_point);
+    return true;
+}
+
+template <CullingMode Culling, QueryType Query, PrimitiveSet Primitives, ReferenceMode References>
+static bool intersectNode(const Node* node, const Ray& ray, ClosestIntersectedObjectInfo& hitInfo, float t_max, Mailbox& mailbox) {
+    if (slabTest(node->bbox, ray) == false){
+        hitInfo.isIntersectedWithAnyObject = false;
+        return false;
+    }
+
+    if (node->is_leaf) {
+        return intersectLeaf<Culling, Query, Primitives, References>(*node, ray, hitInfo, t_max, mailbox);
+    }
+
+    ClosestIntersectedObjectInfo hitInfo1, hitInfo2;
+
+    if (node->left) {
+        intersectNode<Culling, Query, Primitives, References>(node->left, ray, hitInfo1, t_max, mailbox);
+    }
+    if (node->right){
+        intersectNode<Culling, Query, Primitives, References>(node->right, ray, hitInfo2, t_max, mailbox);
+    }
+
+    if(hitInfo1.isIntersectedWithAnyObject){
+        hitInfo = hitInfo1;
+    }
+
+    if(hitInfo2.isIntersectedWithAnyObject){
+        hitInfo = hitInfo2;
+    }
+
+    if(hitInfo2.isIntersectedWithAnyObject && hitInfo1.isIntersectedWithAnyObject){
+        hitInfo = hitInfo1.t < hitInfo2.t ? hitInfo1 : hitInfo2;
+    }
+    return hitInfo.isIntersectedWithAnyObject;
+}
+
+template <CullingMode Culling, PrimitiveSet Primitives, ReferenceMode References>
+static bool closestHit(const Node* head, const Ray& ray, ClosestIntersectedObjectInfo& hitInfo) {
+    Mailbox mailbox;
+    return intersectNode<Culling, QueryType::CLOSEST_HIT, Primitives, References>(head, ray, hitInfo, MAXFLOAT, mailbox);
+}
+
+template <PrimitiveSet Primitives, ReferenceMode References>
+static const Node* anyHitNode(const Node* node, const Ray& ray, float t_max, Mailbox& mailbox) {
+    if (slabTest(node->bbox, ray) == false){
+        return NULL;
+    }
+
+    if (node->is_leaf) {
+        ClosestIntersectedObjectInfo hitInfo;
+        return intersectLeaf<CullingMode::NONE, QueryType::ANY_HIT, Primitives, References>(*node, ray, hitInfo, t_max, mailbox) ? node : NULL;
+    }
+
+    const Node* occluder = node->left ? anyHitNode<Primitives, References>(node->left, ray, t_max, mailbox) : NULL;
+    if (occluder == NULL && node->right){
+        occluder = anyHitNode<Primitives, References>(node->right, ray, t_max, mailbox);
+    }
+    return occluder;
+}
+
+/* Returns the first leaf found to block the ray before t_max, so callers can test it again first */
+template <PrimitiveSet Primitives, ReferenceMode References>
+static const Node* anyHit(const Node* node, const Ray& ray, float t_max) {
+    Mailbox mailbox;
+    return anyHitNode<Primitives, References>(node, ray, t_max, mailbox);
+}
+
+/* Grid step 2^exponent of a wide node axis, assembled from its bits */
+static inline float gridStep(int8_t exponent) {
+    uint32_t bits = static_cast<uint32_t>(exponent + 127) << 23;
+    float step;
+    std::memcpy(&step, &bits, sizeof(step));
+    return step;
+}
+
+/* slabTest against the decoded boxes of all children of a wide node at once. Decoded boxes
+   contain the exact ones and the division is the same, so no child the binary kernel would
+   enter is rejected. Returns the children hit as a bit mask and their entry distances. */
+static inline int intersectChildren(const WideNode& node, const Ray& ray, Float4& t_enter) {
+    Float4 enter(FLT_MIN);
+    Float4 exit(FLT_MAX);
+    for (int axis = 0; axis < 3; axis++){
+        float direction = ray.direction.data[axis];
+        if (direction == 0.0f){
+            continue;
+        }
+        Float4 step(gridStep(node.exponent[axis]));
+        Float4 origin(node.origin[axis]);
+        Float4 start(ray.start_position.data[axis]);
+        Float4 t_lower = (origin + Float4::loadBytes(node.lower[axis]) * step - start) / Float4(direction);
+        Float4 t_upper = (origin + Float4::loadBytes(node.upper[axis]) * step - start) / Float4(direction);
+        enter = Float4::max(enter, Float4::min(t_lower, t_upper));
+        exit = Float4::min(exit, Float4::max(t_lower, t_upper));
+    }
+    t_enter = enter;
+    int missed = Float4::greaterMask(enter, exit).laneMask() | Float4::greaterMask(Float4(0.0f), exit).laneMask();
+    return ~missed & ((1 << node.child_count) - 1);
+}
+
+struct WideStackEntry{
+    int32_t child;
+    float t_enter;
+};
+
+/* Nearest child first, skipping subtrees that start beyond the closest hit. Hits at equal
+   distance go to the later leaf in depth-first order, as in intersectNode, unless rounding puts
+   the later leaf's box entry just past the hit. */
+template <CullingMode Culling, PrimitiveSet Primitives, ReferenceMode References>
+static bool closestHitWide(const WideBVH& bvh, const Ray& ray, ClosestIntersectedObjectInfo& hitInfo) {
+    hitInfo = ClosestIntersectedObjectInfo(false);
+    if (ray.direction == Vec4f()){
+        return false;
+    }
+    Mailbox mailbox;
+    WideStackEntry stack[WIDE_STACK_SIZE];
+    int size = 0;
+    stack[size++] = {0, -MAXFLOAT};
+    float closest_t = MAXFLOAT;
+    long closest_leaf = -1;
+    while (size > 0){
+        WideStackEntry entry = stack[--size];
+        if (entry.t_enter > closest_t){
+            continue;
+        }
+        if (entry.child < 0){
+            long leaf = ~entry.child;
+            ClosestIntersectedObjectInfo leafInfo;
+            if (intersectLeaf<Culling, QueryType::CLOSEST_HIT, Primitives, References>(*bvh.leaves[leaf], ray, leafInfo, MAXFLOAT, mailbox)
+                && (leafInfo.t < closest_t || (leafInfo.t == closest_t && leaf > closest_leaf))){
+                hitInfo = leafInfo;
+                closest_t = leafInfo.t;
+                closest_leaf = leaf;
+            }
+            continue;
+        }
+        const WideNode& node = bvh.nodes[entry.child];
+        Float4 t_enter;
+        int first = size;
+        for (int hits = intersectChildren(node, ray, t_enter); hits; hits &= hits - 1){
+            int i = __builtin_ctz(hits);
+            WideStackEntry child = {node.children[i], t_enter[i]};
+            int j = size++;
+            while (j > first && stack[j - 1].t_enter < child.t_enter){
+                stack[j] = stack[j - 1];
+                j--;
+            }
+            stack[j] = child;
+        }
+    }
+    return closest_leaf >= 0;
+}
+
+template <PrimitiveSet Primitives, ReferenceMode References>
+static const Node* anyHitWide(const WideBVH& bvh, const Ray& ray, float t_max) {
+    if (ray.direction == Vec4f()){
+        return NULL;
+    }
+    Mailbox mailbox;
+    int32_t stack[WIDE_STACK_SIZE];
+    int size = 0;
+    stack[size++] = 0;
+    while (size > 0){
+        int32_t child = stack[--size];
+        if (child < 0){
+            const Node* leaf = bvh.leaves[~child];
+            ClosestIntersectedObjectInfo hitInfo;
+            if (intersectLeaf<CullingMode::NONE, QueryType::ANY_HIT, Primitives, References>(*leaf, ray, hitInfo, t_max, mailbox)){
+                return leaf;
+            }
+            continue;
+        }
+        const WideNode& node = bvh.nodes[child];
+        Float4 t_enter;
+        int hits = intersectChildren(node, ray, t_enter);
+        for (int i = node.child_count - 1; i >= 0; i--){
+            if ((hits >> i & 1) && t_enter[i] <= t_max){
+                stack[size++] = node.children[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+/* max(0, cosAlpha)^phong_exponent for four lanes. Whole exponents, which the parser
+   flags per material, use repeated squaring; any other exponent falls back to pow. */
+static inline Float4 specularPower(const Float4& cosAlpha, const parser::Material& material) {
+    Float4 base = Float4::max(cosAlpha, Float4(0.0f));
+    if (material.integer_phong_exponent >= 0) {
+        return Float4::powi(base, material.integer_phong_exponent);
+    }
+    return Float4(pow(base[0], material.phong_exponent), pow(base[1], material.phong_exponent),
+                  pow(base[2], material.phong_exponent), pow(base[3], material.phong_exponent));
+}
+
+/* Diffuse plus Blinn-Phong specular contribution of every unoccluded point light
+   listed in thread.light_ids. Light vectors, cosines and half vectors are evaluated four lights at a time.
+   Shadow rays are traced unless thread.shadow_visibility holds recorded results for this hit.
+   Every vector is normalized exactly once, so each cosine is a plain dot product:
+   one square root for the light distance and one for the half vector per light.
+
+   With shadow ray culling, a light whose unshadowed contribution, scaled by the path
+   throughput, stays below the threshold on every channel that is not yet saturated
+   is dropped without tracing its shadow ray. With float output nothing saturates, as the
+   float image keeps channels past display white. */
+static RGB shadePointLights(const RenderContext& context, const ClosestIntersectedObjectInfo& hitInfo, const parser::Material& material,
+                            const UnitVec4f& w_camera, const RGB& throughput, const RGB& path_color, ThreadContext& thread) {
+    RGB color(0, 0, 0);
+    const parser::Scene& scene = context.scene;
+    const ShadingSettings& settings = context.settings;
+    const std::vector<parser::PointLight>& point_lights = scene.point_lights;
+    const std::vector<int>& light_ids = thread.light_ids;
+    Vec4f shadow_ray_start_position = hitInfo.intersection_point + hitInfo.unit_normal_vector * scene.shadow_ray_epsilon;
+
+    Vec3fx4 position = Vec3fx4::broadcast(hitInfo.intersection_point);
+    Vec3fx4 normal_vector = Vec3fx4::broadcast(hitInfo.unit_normal_vector);
+    Vec3fx4 camera = Vec3fx4::broadcast(w_camera);
+
+    for (size_t first = 0; first < light_ids.size(); first += 4) {
+        int count = std::min<size_t>(4, light_ids.size() - first);
+        const parser::Vec3f* light_positions[4];
+        for (int i = 0; i < 4; i++) {
+            light_positions[i] = &point_lights[light_ids[first + std::min(i, count - 1)]].position;
+        }
+        Vec3fx4 to_light = Vec3fx4::gather(light_positions) - position;
+
+        Float4 square_distance = Vec3fx4::dot(to_light, to_light);
+        Vec3fx4 w_light = to_light / Float4::sqrt(square_distance);
+        Float4 cosTheta = Vec3fx4::dot(w_light, normal_vector);
+
+        Vec3fx4 h = (w_light + camera).normalize();
+        Float4 cosAlpha = Vec3fx4::dot(h, normal_vector);
+        Float4 specular_power = specularPower(cosAlpha, material);
+
+        int lit = Float4::greaterMask(cosTheta, Float4(0.0f)).laneMask();
+        for (int i = 0; i < count; i++) {
+            if (!(lit & (1 << i))){
+                continue;
+            }
+            const parser::PointLight& pointlight = point_lights[light_ids[first + i]];
+            RGB contribution = RGB((pointlight.intensity * material.diffuse * cosTheta[i]) / square_distance[i])
+                             + RGB(material.specular * pointlight.intensity * specular_power[i] / square_distance[i]);
+
+            if (settings.cull_shadow_rays){
+                int saturated = settings.float_output ? 0 : Float4::greaterMask((path_color + color * throughput).data, Float4(254.5f)).laneMask();
+                int visible = Float4::greaterMask((contribution * throughput).data, Float4(settings.shadow_cull_threshold)).laneMask();
+                if ((visible & ~saturated & 7) == 0){
+                    thread.stats.shadow_rays_culled++;
+                    continue;
+                }
+            }
+
+            int light = light_ids[first + i];
+            if (thread.shadow_visibility){
+                thread.stats.shadow_rays_reused++;
+                if (!((thread.shadow_visibility[light / 64] >> (light % 64)) & 1)){
+                    continue;
+                }
+            }
+            else{
+                thread.stats.shadow_rays_traced++;
+                Ray ray_to_light = Ray(shadow_ray_start_position, Vec4f(pointlight.position) - shadow_ray_start_position);
+                if (context.tree.isOccluded(ray_to_light, 1, thread.last_occluders[light], thread.stats)){
+                    continue;
+                }
+            }
+            color = color + contribution;
+        }
+    }
+    return color;
+}
+
+/* Deferred counterpart of shadePointLights for the hits [begin, end) of one material.
+   Lights are the outer loop and hits are evaluated four at a time, so the material stays
+   in registers and consecutive shadow rays towards one light reuse its occluder cache.
+   Each hit still adds its lights in scene order, so results match the inline path. */
+static void shadeHits(const RenderContext& context, const GBuffer& hits, int begin, int end,
+                      const parser::Material& material, ThreadContext& thread, RGB* lights) {
+    const parser::Scene& scene = context.scene;
+    const ShadingSettings& settings = context.settings;
+
+    for (int hit = begin; hit < end; hit++) {
+        lights[hit] = RGB(0, 0, 0);
+    }
+
+    for (size_t light = 0; light < scene.point_lights.size(); light++) {
+        const parser::PointLight& pointlight = scene.point_lights[light];
+        Vec3fx4 light_position = Vec3fx4::broadcast(pointlight.position);
+
+        for (int first = begin; first < end; first += 4) {
+            int count = std::min(4, end - first);
+            Vec3fx4 position = Vec3fx4::load(&hits.position_x[first], &hits.position_y[first], &hits.position_z[first]);
+            Vec3fx4 normal_vector = Vec3fx4::load(&hits.normal_x[first], &hits.normal_y[first], &hits.normal_z[first]);
+            Vec3fx4 camera = Vec3fx4::load(&hits.view_x[first], &hits.view_y[first], &hits.view_z[first]);
+            Vec3fx4 to_light = light_position - position;
+
+            Float4 square_distance = Vec3fx4::dot(to_light, to_light);
+            Vec3fx4 w_light = to_light / Float4::sqrt(square_distance);
+            Float4 cosTheta = Vec3fx4::dot(w_light, normal_vector);
+
+            Vec3fx4 h = (w_light + camera).normalize();
+            Float4 cosAlpha = Vec3fx4::dot(h, normal_vector);
+            Float4 specular_power = specularPower(cosAlpha, material);
+
+            int lit = Float4::greaterMask(cosTheta, Float4(0.0f)).laneMask();
+            for (int i = 0; i < count; i++) {
+                if (!(lit & (1 << i))){
+                    continue;
+                }
+                int hit = first + i;
+                RGB contribution = RGB((pointlight.intensity * material.diffuse * cosTheta[i]) / square_distance[i])
+                                 + RGB(material.specular * pointlight.intensity * specular_power[i] / square_distance[i]);
+
+                if (settings.cull_shadow_rays){
+                    int saturated = settings.float_output ? 0
+                                  : Float4::greaterMask((hits.path_colors[hit] + lights[hit] * hits.throughputs[hit]).data, Float4(254.5f)).laneMask();
+                    int visible = Float4::greaterMask((contribution * hits.throughputs[hit]).data, Float4(settings.shadow_cull_threshold)).laneMask();
+                    if ((visible & ~saturated & 7) == 0){
+                        thread.stats.shadow_rays_culled++;
+                        continue;
+                    }
+                }
+
+                thread.stats.shadow_rays_traced++;
+                Vec4f shadow_ray_start_position = hits.position(hit) + hits.normal(hit) * scene.shadow_ray_epsilon;
+                Ray ray_to_light = Ray(shadow_ray_start_position, Vec4f(pointlight.position) - shadow_ray_start_position);
+                if (context.tree.isOccluded(ray_to_light, 1, thread.last_occluders[light], thread.stats)){
+                    continue;
+                }
+                lights[hit] = lights[hit] + contribution;
+            }
+        }
+    }
+}
+
+/* The single quantization pass: clamps to [0, 255], rounds half up and writes interleaved 8-bit RGB */
+static void packPixels(const RGB* colors, int count, unsigned char* pixels) {
+    Float4 lower(0.0f);
+    Float4 upper(255.0f);
+    Float4 half(0.5f);
+    int channels[4];
+    for (int i = 0; i < count; i++){
+        (Float4::min(Float4::max(colors[i].data, lower), upper) + half).storeTruncated(channels);
+        pixels[3 * i] = channels[0];
+        pixels[3 * i + 1] = channels[1];
+        pixels[3 * i + 2] = channels[2];
+    }
+}
+
+}
+
+const KernelSet KERNEL_SET = {
+    KERNEL_SET_NAME,
+    {
+        {
+            {
+                KERNEL_NAMESPACE::closestHit<CullingMode::NONE, PrimitiveSet::TRIANGLES_ONLY, ReferenceMode::UNIQUE>,
+                KERNEL_NAMESPACE::closestHit<CullingMode::NONE, PrimitiveSet::SPHERES_ONLY, ReferenceMode::UNIQUE>,
+                KERNEL_NAMESPACE::closestHit<CullingMode::NONE, PrimitiveSet::MIXED, ReferenceMode::UNIQUE>
+            },
+            {
+                KERNEL_NAMESPACE::closestHit<CullingMode::BACKFACE, PrimitiveSet::TRIANGLES_ONLY, ReferenceMode::UNIQUE>,
+                KERNEL_NAMESPACE::closestHit<CullingMode::BACKFACE, PrimitiveSet::SPHERES_ONLY, ReferenceMode::UNIQUE>,
+                KERNEL_NAMESPACE::closestHit<CullingMode::BACKFACE, PrimitiveSet::MIXED, ReferenceMode::UNIQUE>
+            }
+        },
+        {
+            {
+                KERNEL_NAMESPACE::closestHit<CullingMode::NONE, PrimitiveSet::TRIANGLES_ONLY, ReferenceMode::DUPLICATED>,
+                KERNEL_NAMESPACE::closestHit<CullingMode::NONE, PrimitiveSet::SPHERES_ONLY, ReferenceMode::DUPLICATED>,
+                KERNEL_NAMESPACE::closestHit<CullingMode::NONE, PrimitiveSet::MIXED, ReferenceMode::DUPLICATED>
+            },
+            {
+                KERNEL_NAMESPACE::closestHit<CullingMode::BACKFACE, PrimitiveSet::TRIANGLES_ONLY, ReferenceMode::DUPLICATED>,
+                KERNEL_NAMESPACE::closestHit<CullingMode::BACKFACE, PrimitiveSet::SPHERES_ONLY, ReferenceMode::DUPLICATED>,
+                KERNEL_NAMESPACE::closestHit<CullingMode::BACKFACE, PrimitiveSet::MIXED, ReferenceMode::DUPLICATED>
+            }
+        }
+    },
+    {
+        {
+            KERNEL_NAMESPACE::anyHit<PrimitiveSet::TRIANGLES_ONLY, ReferenceMode::UNIQUE>,
+            KERNEL_NAMESPACE::anyHit<PrimitiveSet::SPHERES_ONLY, ReferenceMode::UNIQUE>,
+            KERNEL_NAMESPACE::anyHit<PrimitiveSet::MIXED, ReferenceMode::UNIQUE>
+        },
+        {
+            KERNEL_NAMESPACE::anyHit<PrimitiveSet::TRIANGLES_ONLY, ReferenceMode::DUPLICATED>,
+            KERNEL_NAMESPACE::anyHit<PrimitiveSet::SPHERES_ONLY, ReferenceMode::DUPLICATED>,
+            KERNEL_NAMESPACE::anyHit<PrimitiveSet::MIXED, ReferenceMode::DUPLICATED>
+        }
+    },
+    {
+        {
+            {
+                KERNEL_NAMESPACE::closestHitWide<CullingMode::NONE, PrimitiveSet::TRIANGLES_ONLY, ReferenceMode::UNIQUE>,
+                KERNEL_NAMESPACE::closestHitWide<CullingMode::NONE, PrimitiveSet::SPHERES_ONLY, ReferenceMode::UNIQUE>,
+                KERNEL_NAMESPACE::closestHitWide<CullingMode::NONE, PrimitiveSet::MIXED, ReferenceMode::UNIQUE>
+            },
+            {
+                KERNEL_NAMESPACE::closestHitWide<CullingMode::BACKFACE, PrimitiveSet::TRIANGLES_ONLY, ReferenceMode::UNIQUE>,
+                KERNEL_NAMESPACE::closestHitWide<CullingMode::BACKFACE, PrimitiveSet::SPHERES_ONLY, ReferenceMode::UNIQUE>,
+                KERNEL_NAMESPACE::closestHitWide<CullingMode::BACKFACE, PrimitiveSet::MIXED, ReferenceMode::UNIQUE>
+            }
+        },
+        {
+            {
+                KERNEL_NAMESPACE::closestHitWide<CullingMode::NONE, PrimitiveSet::TRIANGLES_ONLY, ReferenceMode::DUPLICATED>,
+                KERNEL_NAMESPACE::closestHitWide<CullingMode::NONE, PrimitiveSet::SPHERES_ONLY, ReferenceMode::DUPLICATED>,
+                KERNEL_NAMESPACE::closestHitWide<CullingMode::NONE, PrimitiveSet::MIXED, ReferenceMode::DUPLICATED>
+            },
+            {
+                KERNEL_NAMESPACE::closestHitWide<CullingMode::BACKFACE, PrimitiveSet::TRIANGLES_ONLY, ReferenceMode::DUPLICATED>,
+                KERNEL_NAMESPACE::closestHitWide<CullingMode::BACKFACE, PrimitiveSet::SPHERES_ONLY, ReferenceMode::DUPLICATED>,
+                KERNEL_NAMESPACE::closestHitWide<CullingMode::BACKFACE, PrimitiveSet::MIXED, ReferenceMode::DUPLICATED>
+            }
+        }
+    },
+    {
+        {
+            KERNEL_NAMESPACE::anyHitWide<PrimitiveSet::TRIANGLES_ONLY, ReferenceMode::UNIQUE>,
+            KERNEL_NAMESPACE::anyHitWide<PrimitiveSet::SPHERES_ONLY, ReferenceMode::UNIQUE>,
+            KERNEL_NAMESPACE::anyHitWide<PrimitiveSet::MIXED, ReferenceMode::UNIQUE>
+        },
+        {
+            KERNEL_NAMESPACE::anyHitWide<PrimitiveSet::TRIANGLES_ONLY, ReferenceMode::DUPLICATED>,
+            KERNEL_NAMESPACE::anyHitWide<PrimitiveSet::SPHERES_ONLY, ReferenceMode::DUPLICATED>,
+            KERNEL_NAMESPACE::anyHitWide<PrimitiveSet::MIXED, ReferenceMode::DUPLICATED>
+        }
+    },
+    KERNEL_NAMESPACE::shadePointLights,
+    KERNEL_NAMESPACE::shadeHits,
+    KERNEL_NAMESPACE::packPixels
+};
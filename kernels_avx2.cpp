@@ -0,0 +1,19 @@
+#include "bvh.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#pragma GCC push_options
+/* Keep results bit-identical to the generic kernels: no FMA contraction */
+#pragma GCC optimize("fp-contract=off")
+#pragma GCC target("avx2,fma,bmi,bmi2,popcnt")
+
+#define KERNEL_NAMESPACE avx2_kernel_impl
+#define KERNEL_SET avx2_kernels
+#define KERNEL_SET_NAME "avx2"
+#include "kernels.inl"
+
+#pragma GCC pop_options
+
+#endif
@@ -0,0 +1,19 @@
+#include "bvh.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#pragma GCC push_options
+/* Keep results bit-identical to the generic kernels: no FMA contraction */
+#pragma GCC optimize("fp-contract=off")
+#pragma GCC target("avx512f,avx512vl,avx512bw,avx512dq,avx2,fma,bmi,bmi2,popcnt")
+
+#define KERNEL_NAMESPACE avx512_kernel_impl
+#define KERNEL_SET avx512_kernels
+#define KERNEL_SET_NAME "avx512"
+#include "kernels.inl"
+
+#pragma GCC pop_options
+
+#endif
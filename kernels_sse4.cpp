@@ -0,0 +1,17 @@
+#include "bvh.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#pragma GCC push_options
+#pragma GCC target("sse4.2,popcnt")
+
+#define KERNEL_NAMESPACE sse4_kernel_impl
+#define KERNEL_SET sse4_kernels
+#define KERNEL_SET_NAME "sse4"
+#include "kernels.inl"
+
+#pragma GCC pop_options
+
+#endif
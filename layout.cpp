@@ -0,0 +1,133 @@
+#include "layout.h"
+#include <cstdint>
+#include <unordered_map>
+
+/* Room for four 112-byte nodes: two levels of a subtree plus one more node */
+static const size_t CLUSTER_BYTES = 512;
+static const size_t CACHE_LINE_BYTES = 64;
+
+static void depthFirst(const Node* root, vector<const Node*>& order){
+    vector<const Node*> stack(1, root);
+    while (!stack.empty()){
+        const Node* node = stack.back();
+        stack.pop_back();
+        order.push_back(node);
+        if (node->right){
+            stack.push_back(node->right);
+        }
+        if (node->left){
+            stack.push_back(node->left);
+        }
+    }
+}
+
+static int height(const Node* node){
+    int levels = 0;
+    for (const Node* child : {node->left, node->right}){
+        if (child){
+            levels = max(levels, height(child));
+        }
+    }
+    return levels + 1;
+}
+
+/* Lays out the first `levels` levels under node; the nodes one level below them go to below */
+static void vanEmdeBoas(const Node* node, int levels, vector<const Node*>& order, vector<const Node*>& below){
+    if (levels == 1){
+        order.push_back(node);
+        for (const Node* child : {node->left, node->right}){
+            if (child){
+                below.push_back(child);
+            }
+        }
+        return;
+    }
+    int top_levels = levels / 2;
+    vector<const Node*> middle;
+    vanEmdeBoas(node, top_levels, order, middle);
+    for (const Node* subtree : middle){
+        vanEmdeBoas(subtree, levels - top_levels, order, below);
+    }
+}
+
+/* cluster_starts receives the index in order of every cluster's first node */
+static void clustered(const Node* root, vector<const Node*>& order, vector<size_t>& cluster_starts){
+    cluster_starts.push_back(order.size());
+    const size_t capacity = max<size_t>(1, CLUSTER_BYTES / sizeof(Node));
+    vector<const Node*> candidates(1, root);
+    vector<const Node*> outside;
+    for (size_t taken = 0; taken < capacity && !candidates.empty(); taken++){
+        auto largest = candidates.begin();
+        for (auto candidate = candidates.begin(); candidate != candidates.end(); candidate++){
+            if ((*candidate)->bbox.halfArea() > (*largest)->bbox.halfArea()){
+                largest = candidate;
+            }
+        }
+        const Node* node = *largest;
+        candidates.erase(largest);
+        order.push_back(node);
+        for (const Node* child : {node->left, node->right}){
+            if (child){
+                candidates.push_back(child);
+            }
+        }
+    }
+    for (const Node* subtree : candidates){
+        clustered(subtree, order, cluster_starts);
+    }
+}
+
+Node* layoutNodes(Node* root, NodeLayout layout, Arena& arena){
+    vector<const Node*> order;
+    vector<size_t> cluster_starts(1, 0);
+    if (layout == NodeLayout::DEPTH_FIRST){
+        depthFirst(root, order);
+    }
+    else if (layout == NodeLayout::VAN_EMDE_BOAS){
+        vector<const Node*> below;
+        vanEmdeBoas(root, height(root), order, below);
+    }
+    else if (layout == NodeLayout::CLUSTERED){
+        cluster_starts.clear();
+        clustered(root, order, cluster_starts);
+    }
+    else{
+        return root;
+    }
+
+    /* Nodes follow each other within a cluster. A cluster that would straddle more cache
+       lines than its size needs starts on the next line instead; padding every cluster
+       would spread the small ones near the leaves over more lines than it saves. */
+    vector<size_t> offsets(order.size());
+    size_t bytes = 0;
+    for (size_t c = 0; c < cluster_starts.size(); c++){
+        size_t end = c + 1 < cluster_starts.size() ? cluster_starts[c + 1] : order.size();
+        size_t cluster_bytes = (end - cluster_starts[c]) * sizeof(Node);
+        size_t lines = (cluster_bytes + CACHE_LINE_BYTES - 1) / CACHE_LINE_BYTES;
+        if (bytes % CACHE_LINE_BYTES + cluster_bytes > lines * CACHE_LINE_BYTES){
+            bytes = (bytes + CACHE_LINE_BYTES - 1) & ~(CACHE_LINE_BYTES - 1);
+        }
+        for (size_t i = cluster_starts[c]; i < end; i++){
+            offsets[i] = bytes;
+            bytes += sizeof(Node);
+        }
+    }
+    /* Arena blocks are only 16-byte aligned */
+    uintptr_t raw = reinterpret_cast<uintptr_t>(arena.allocate(bytes + CACHE_LINE_BYTES, 16));
+    char* base = reinterpret_cast<char*>((raw + CACHE_LINE_BYTES - 1) & ~static_cast<uintptr_t>(CACHE_LINE_BYTES - 1));
+    std::unordered_map<const Node*, Node*> placed;
+    placed.reserve(order.size());
+    for (size_t i = 0; i < order.size(); i++){
+        placed[order[i]] = reinterpret_cast<Node*>(base + offsets[i]);
+    }
+    for (size_t i = 0; i < order.size(); i++){
+        Node* node = new (placed[order[i]]) Node(*order[i]);
+        if (node->left){
+            node->left = placed[node->left];
+        }
+        if (node->right){
+            node->right = placed[node->right];
+        }
+    }
+    return placed[root];
+}
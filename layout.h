@@ -0,0 +1,23 @@
+#ifndef __HW1__LAYOUT__
+#define __HW1__LAYOUT__
+
+#include "node.h"
+#include "arena.h"
+#include "common.h"
+
+/* Copies the tree into one array from arena in the given order and returns the new root; the
+   old nodes stay behind unused until the arena goes. Builders allocate nodes as they split, which
+   for the median builder is depth-first order and for the others is scattered.
+
+   DEPTH_FIRST      parent, left subtree, right subtree: left children sit next to their parent,
+                    right children drift a whole subtree away
+   VAN_EMDE_BOAS    the top half of the levels first, then every subtree hanging below it, each
+                    laid out the same way, so every cache block holds whole subtrees whatever its size
+   CLUSTERED        clusters of CLUSTER_BYTES grown from a root by taking the largest box next,
+                    the node a ray is likeliest to visit; clusters follow each other depth-first,
+                    and one that would straddle more cache lines than its size needs starts a new line
+
+   The array starts on a cache line. */
+Node* layoutNodes(Node* root, NodeLayout layout, Arena& arena);
+
+#endif
@@ -0,0 +1,152 @@
+#include "lbvh.h"
+#include "morton.h"
+#include "parallel.h"
+#include <cstdint>
+
+/* Length of the common prefix of the codes of sorted primitives i and j, -1 outside the
+   array. Equal codes fall back to the indices, so every key is distinct. */
+static inline int commonPrefix(const vector<uint64_t>& codes, int i, int j){
+    if (j < 0 || j >= static_cast<int>(codes.size())){
+        return -1;
+    }
+    if (codes[i] == codes[j]){
+        return 64 + __builtin_clz(static_cast<uint32_t>(i ^ j));
+    }
+    return __builtin_clzll(codes[i] ^ codes[j]);
+}
+
+/* Stable LSD radix sort of the codes, eight bits per pass, carrying ids along */
+static void radixSort(vector<uint64_t>& codes, vector<uint32_t>& ids, int bits){
+    vector<uint64_t> sorted_codes(codes.size());
+    vector<uint32_t> sorted_ids(ids.size());
+    for (int shift = 0; shift < bits; shift += 8){
+        size_t offsets[257] = {0};
+        for (uint64_t code : codes){
+            offsets[((code >> shift) & 0xFF) + 1]++;
+        }
+        for (int digit = 0; digit < 256; digit++){
+            offsets[digit + 1] += offsets[digit];
+        }
+        for (size_t i = 0; i < codes.size(); i++){
+            size_t position = offsets[(codes[i] >> shift) & 0xFF]++;
+            sorted_codes[position] = codes[i];
+            sorted_ids[position] = ids[i];
+        }
+        codes.swap(sorted_codes);
+        ids.swap(sorted_ids);
+    }
+}
+
+/* Levels top-down and boxes bottom-up, which the parallel pass cannot know */
+static void finishNode(Node* node, int level){
+    node->level = level;
+    Node::max_level = max(Node::max_level, level);
+    if (node->is_leaf){
+        return;
+    }
+    finishNode(node->left, level + 1);
+    finishNode(node->right, level + 1);
+    node->bbox = BBox::merge(node->left->bbox, node->right->bbox);
+}
+
+Node* buildLinearBVH(PrimitiveList<Triangle> triangles, PrimitiveList<Sphere> spheres, int morton_bits, Arena& arena){
+    int triangle_count = triangles.size();
+    int count = triangle_count + spheres.size();
+    if (count <= 1){
+        return arena.create<Node>(triangles, spheres, 1, arena);
+    }
+
+    /* Ids below triangle_count are triangles, the rest spheres */
+    auto centroid = [&](int id) -> Vec4f {
+        return id < triangle_count ? Vec4f(triangles.first[id]->centeroid) : Vec4f(spheres.first[id - triangle_count]->center);
+    };
+    Vec4f min_point = centroid(0);
+    Vec4f max_point = min_point;
+    for (int id = 1; id < count; id++){
+        min_point = Vec4f::min(min_point, centroid(id));
+        max_point = Vec4f::max(max_point, centroid(id));
+    }
+
+    vector<uint64_t> codes(count);
+    vector<uint32_t> ids(count);
+    parallelFor(count, [&](size_t begin, size_t end) {
+        for (size_t id = begin; id < end; id++){
+            codes[id] = morton_bits > 30 ? morton63(centroid(id), min_point, max_point) : morton30(centroid(id), min_point, max_point);
+            ids[id] = id;
+        }
+    });
+    radixSort(codes, ids, morton_bits > 30 ? 63 : 30);
+
+    /* Both arrays take the sorted order; any range of sorted primitives is then one range of
+       triangles and one of spheres, found through the triangles sorted before it */
+    vector<Triangle*> sorted_triangles;
+    vector<Sphere*> sorted_spheres;
+    vector<int> triangles_before(count + 1);
+    sorted_triangles.reserve(triangle_count);
+    sorted_spheres.reserve(count - triangle_count);
+    for (int k = 0; k < count; k++){
+        triangles_before[k] = sorted_triangles.size();
+        if (static_cast<int>(ids[k]) < triangle_count){
+            sorted_triangles.push_back(triangles.first[ids[k]]);
+        }
+        else{
+            sorted_spheres.push_back(spheres.first[ids[k] - triangle_count]);
+        }
+    }
+    triangles_before[count] = triangle_count;
+    std::copy(sorted_triangles.begin(), sorted_triangles.end(), triangles.first);
+    std::copy(sorted_spheres.begin(), sorted_spheres.end(), spheres.first);
+
+    auto assignRange = [&](Node& node, int first, int last) {
+        node.triangles = PrimitiveList<Triangle>(triangles.first + triangles_before[first], triangles.first + triangles_before[last]);
+        node.spheres = PrimitiveList<Sphere>(spheres.first + (first - triangles_before[first]), spheres.first + (last - triangles_before[last]));
+    };
+
+    Node* inner = arena.allocateArray<Node>(count - 1);
+    Node* leaves = arena.allocateArray<Node>(count);
+    parallelFor(count, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++){
+            Node* leaf = new (&leaves[k]) Node();
+            leaf->is_leaf = true;
+            assignRange(*leaf, k, k + 1);
+            leaf->setMinAndMaxPoints();
+        }
+    });
+    parallelFor(count - 1, [&](size_t begin, size_t end) {
+        for (int i = begin; i < static_cast<int>(end); i++){
+            /* The node's range extends from i in the direction of the longer common prefix */
+            int direction = commonPrefix(codes, i, i + 1) > commonPrefix(codes, i, i - 1) ? 1 : -1;
+            int prefix_min = commonPrefix(codes, i, i - direction);
+            int length_max = 2;
+            while (commonPrefix(codes, i, i + length_max * direction) > prefix_min){
+                length_max *= 2;
+            }
+            int length = 0;
+            for (int step = length_max / 2; step >= 1; step /= 2){
+                if (commonPrefix(codes, i, i + (length + step) * direction) > prefix_min){
+                    length += step;
+                }
+            }
+            int j = i + length * direction;
+
+            /* The split is where the node's common prefix grows by a bit */
+            int node_prefix = commonPrefix(codes, i, j);
+            int split = 0;
+            int step = length;
+            do {
+                step = (step + 1) / 2;
+                if (commonPrefix(codes, i, i + (split + step) * direction) > node_prefix){
+                    split += step;
+                }
+            } while (step > 1);
+            int gamma = i + split * direction + min(direction, 0);
+
+            Node* node = new (&inner[i]) Node();
+            node->left = min(i, j) == gamma ? &leaves[gamma] : &inner[gamma];
+            node->right = max(i, j) == gamma + 1 ? &leaves[gamma + 1] : &inner[gamma + 1];
+            assignRange(*node, min(i, j), max(i, j) + 1);
+        }
+    }, 1024);
+    finishNode(&inner[0], 1);
+    return &inner[0];
+}
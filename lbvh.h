@@ -0,0 +1,16 @@
+#ifndef __HW1__LBVH__
+#define __HW1__LBVH__
+
+#include "node.h"
+#include "arena.h"
+
+/* Linear BVH: primitives are sorted by the Morton code of their centroids (30 or 63 bits,
+   radix sorted), and the tree is the binary radix tree of the sorted codes, every inner node
+   found independently of the others (Karras, 2012). Much faster to build than the median
+   split tree on large meshes, at some cost in tree quality.
+
+   Sorts the two primitive arrays in place; nodes refer to ranges of them like the median
+   builder's. Returns the root, allocated with every other node from arena. */
+Node* buildLinearBVH(PrimitiveList<Triangle> triangles, PrimitiveList<Sphere> spheres, int morton_bits, Arena& arena);
+
+#endif
@@ -0,0 +1,109 @@
+#include "lightbvh.h"
+#include <algorithm>
+
+static const int MAX_LIGHTS_PER_LEAF = 4;
+
+LightBVH::LightBVH(const parser::Scene& scene): scene(scene) {
+    for (size_t i = 0; i < scene.point_lights.size(); i++){
+        light_ids.push_back(i);
+    }
+    if (!light_ids.empty()){
+        build(0, light_ids.size());
+    }
+}
+
+int LightBVH::build(int begin, int end){
+    int index = nodes.size();
+    nodes.push_back(LightNode());
+
+    Vec4f min_point = parser::Vec3f::MAXVEC;
+    Vec4f max_point = parser::Vec3f::MINVEC;
+    Vec4f intensity;
+    for (int i = begin; i < end; i++){
+        const parser::PointLight& light = scene.point_lights[light_ids[i]];
+        min_point = Vec4f::min(min_point, light.position);
+        max_point = Vec4f::max(max_point, light.position);
+        intensity = intensity + light.intensity;
+    }
+    nodes[index].min_point = min_point;
+    nodes[index].max_point = max_point;
+    nodes[index].intensity = intensity;
+
+    if (end - begin <= MAX_LIGHTS_PER_LEAF){
+        nodes[index].first = begin;
+        nodes[index].count = end - begin;
+        nodes[index].right = -1;
+        return index;
+    }
+
+    Vec4f extent = max_point - min_point;
+    int axis = 0;
+    if (extent.y() > extent.x()) axis = 1;
+    if (extent.z() > (axis == 0 ? extent.x() : extent.y())) axis = 2;
+
+    int middle = (begin + end) / 2;
+    const std::vector<parser::PointLight>& lights = scene.point_lights;
+    std::nth_element(light_ids.begin() + begin, light_ids.begin() + middle, light_ids.begin() + end,
+        [&lights, axis](int l1, int l2) {
+            const parser::Vec3f& p1 = lights[l1].position;
+            const parser::Vec3f& p2 = lights[l2].position;
+            return axis == 0 ? p1.x < p2.x : (axis == 1 ? p1.y < p2.y : p1.z < p2.z);
+        });
+
+    nodes[index].first = -1;
+    nodes[index].count = 0;
+    build(begin, middle);
+    int right = build(middle, end);
+    nodes[index].right = right;             // build() may have reallocated nodes
+    return index;
+}
+
+void LightBVH::selectLights(const Vec4f& position, const UnitVec4f& normal_vector, const parser::Material& material,
+                            const RGB& throughput, const RGB& path_color, const ShadingSettings& settings,
+                            std::vector<int>& selected, RenderStats& stats) const {
+    selected.clear();
+    if (nodes.empty()){
+        return;
+    }
+
+    Float4 reflectance = (Vec4f(material.diffuse) + Vec4f(material.specular)).data * throughput.data;
+    int saturated = settings.float_output ? 0 : Float4::greaterMask(path_color.data, Float4(254.5f)).laneMask() & 7;
+    Float4 budget(settings.light_error_budget);
+    Float4 zero(0.0f);
+
+    int stack[64];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0){
+        int index = stack[--stack_size];
+        const LightNode& node = nodes[index];
+
+        /* The box corner furthest along the normal decides whether any light is above the surface */
+        Float4 toward_normal = Float4::select(Float4::greaterMask(normal_vector.data, zero), node.max_point.data, node.min_point.data);
+        if ((Vec4f(toward_normal) - position).dotProductWith(normal_vector) <= 0){
+            continue;
+        }
+
+        Vec4f outside = Vec4f(Float4::max(Float4::max(node.min_point.data - position.data, position.data - node.max_point.data), zero));
+        float square_distance = outside.dotProductWith(outside);
+        if (square_distance > 0){
+            Float4 bound = reflectance * node.intensity.data / Float4(square_distance);
+            int significant = Float4::greaterMask(bound, budget).laneMask() & 7;
+            if ((significant & ~saturated) == 0){
+                budget = budget - bound;
+                continue;
+            }
+        }
+
+        if (node.count > 0){
+            selected.insert(selected.end(), light_ids.begin() + node.first, light_ids.begin() + node.first + node.count);
+        }
+        else{
+            stack[stack_size++] = node.right;
+            stack[stack_size++] = index + 1;
+        }
+    }
+    std::sort(selected.begin(), selected.end());
+    stats.lights_considered += scene.point_lights.size();
+    stats.lights_selected += selected.size();
+}
@@ -0,0 +1,44 @@
+#ifndef __HW1__LIGHTBVH__
+#define __HW1__LIGHTBVH__
+
+#include <vector>
+#include "parser.h"
+#include "common.h"
+#include "vecmath.h"
+#include "stats.h"
+
+struct LightNode{
+    Vec4f min_point;
+    Vec4f max_point;
+    Vec4f intensity;                    // summed intensity of every light below, per channel
+    int first;                          // leaf: first slot in light_ids
+    int count;                          // leaf: number of lights, 0 for inner nodes
+    int right;                          // inner: index of the right child, the left child follows directly
+};
+
+/* Bounding volume hierarchy over the point lights of a scene. A node's lights can
+   contribute at most (kd + ks) * summed intensity / squared distance to its box,
+   which lets a shading point skip whole groups of far or dim lights. */
+class LightBVH{
+    public:
+        std::vector<LightNode> nodes;
+        std::vector<int> light_ids;
+
+        LightBVH(const parser::Scene& scene);
+
+        /* Appends the lights that may light `position` to `selected`, in ascending light order.
+           Nodes behind the surface are dropped exactly. Nodes whose bound, scaled by the path
+           throughput, fits into the remaining settings.light_error_budget on every unsaturated
+           channel are dropped as well; the budget is spent in a fixed order, so results are
+           deterministic. With settings.float_output no channel is saturated. */
+        void selectLights(const Vec4f& position, const UnitVec4f& normal_vector, const parser::Material& material,
+                          const RGB& throughput, const RGB& path_color, const ShadingSettings& settings,
+                          std::vector<int>& selected, RenderStats& stats) const;
+
+    private:
+        const parser::Scene& scene;
+
+        int build(int begin, int end);
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef __HW1__MORTON__
+#define __HW1__MORTON__
+
+#include <cstdint>
+#include "vecmath.h"
+
+/* Morton (Z-order) codes of points inside a box: the bits of the three quantized
+   coordinates interleaved, x highest. Points close in space get close codes. */
+
+/* Spreads the low 10 bits of v so that two zero bits follow each */
+inline uint32_t expandBits10(uint32_t v){
+    v &= 0x3FF;
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v << 8)) & 0x0300F00F;
+    v = (v | (v << 4)) & 0x030C30C3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+/* Same for the low 21 bits */
+inline uint64_t expandBits21(uint64_t v){
+    v &= 0x1FFFFF;
+    v = (v | (v << 32)) & 0x1F00000000FFFFull;
+    v = (v | (v << 16)) & 0x1F0000FF0000FFull;
+    v = (v | (v << 8)) & 0x100F00F00F00F00Full;
+    v = (v | (v << 4)) & 0x10C30C30C30C30C3ull;
+    v = (v | (v << 2)) & 0x1249249249249249ull;
+    return v;
+}
+
+/* Position of point in [min_point, max_point] scaled to [0, cells - 1] on every axis */
+inline Vec4f mortonCell(const Vec4f& point, const Vec4f& min_point, const Vec4f& max_point, float cells){
+    Vec4f extent = Vec4f::max(max_point - min_point, Vec4f(1e-20f, 1e-20f, 1e-20f));
+    Vec4f scaled = (point - min_point) / extent * (cells - 1.0f);
+    return Vec4f::min(Vec4f::max(scaled, Vec4f(0.0f, 0.0f, 0.0f)), Vec4f(cells - 1.0f, cells - 1.0f, cells - 1.0f));
+}
+
+inline uint32_t morton30(const Vec4f& point, const Vec4f& min_point, const Vec4f& max_point){
+    Vec4f cell = mortonCell(point, min_point, max_point, 1024.0f);
+    return (expandBits10(static_cast<uint32_t>(cell.x())) << 2) | (expandBits10(static_cast<uint32_t>(cell.y())) << 1)
+        | expandBits10(static_cast<uint32_t>(cell.z()));
+}
+
+inline uint64_t morton63(const Vec4f& point, const Vec4f& min_point, const Vec4f& max_point){
+    Vec4f cell = mortonCell(point, min_point, max_point, 2097152.0f);
+    return (expandBits21(static_cast<uint64_t>(cell.x())) << 2) | (expandBits21(static_cast<uint64_t>(cell.y())) << 1)
+        | expandBits21(static_cast<uint64_t>(cell.z()));
+}
+
+#endif